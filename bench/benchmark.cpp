@@ -0,0 +1,551 @@
+#include "../src/ray_tracer.h"
+
+#include "../src/bvh.h"
+#include "../src/camera.h"
+#include "../src/accelerator.h"
+#include "../src/compressed_scene.h"
+#include "../src/hittable_list.h"
+#include "../src/input.h"
+#include "../src/lazy_bvh.h"
+#include "../src/log.h"
+#include "../src/sbvh.h"
+#include "../src/scenes.h"
+#include "../src/static_scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ============================================================
+// RayTracerBench
+//
+// End-to-end benchmark: renders the built-in scenes plus five
+// generated ones (a large terrain mesh loaded through the OBJ
+// parser, the same mesh as an enclosed cave where secondary
+// rays dominate, a scene with many small lights, a turntable of
+// moving instances, and long, thin triangles) at a fixed seed,
+// resolution and sample count, then compares the timings with
+// a stored baseline.
+//
+// The turntable scene first moves its instances through a short
+// animation and prints the time of a BVH refit per frame against
+// a full rebuild; its last pose is then built and rendered like
+// the other scenes.
+//
+// Usage: RayTracerBench [--baseline file] [--update-baseline]
+//                       [--tolerance 0.15] [--runs 3] [--scene name]
+//                       [--packets 4|8] [--wavefront [--reorder]]
+//                       [--specialized] [--compressed 8|16] [--arena]
+//                       [--paged MB] [--lazy] [--accel bvh|grid|auto]
+//                       [--build median|lbvh|lbvh_optimized] [--sbvh]
+//
+// --packets, --wavefront and --reorder select the camera's render mode, so
+// modes can be compared against the same (default mode) baseline.
+// --specialized renders through static_scene (the flattened BVH with
+// compile-time primitive types) where the scene allows it.
+// --compressed does the same with 8- or 16-bit quantized node
+// bounds (compressed_scene.h) and prints the size of both trees.
+// --paged renders the terrain scenes out of core (paged_mesh.h) with
+// the given cache size; parse time then includes writing the paged
+// file, and the cache miss rate is printed after each scene.
+// --lazy builds only the top of each BVH (lazy_bvh.h); build time
+// then covers that part, and the first render, which builds the
+// subtrees its rays reach, is printed after each scene.
+// --accel grid renders through a uniform grid (grid.h) instead of
+// the BVH, and --accel auto lets choose_accelerator() pick per
+// scene; the grid ignores the BVH options above.
+// --build selects how bvh_node trees are built (bvh_split_method):
+// the median split, the linear BVH, or the linear BVH improved by
+// tree rotations; compare their build and render times.
+// --sbvh builds with spatial splits (sbvh.h) instead, and first
+// prints the SAH traversal cost of each scene with and without
+// them (report_spatial_splits()).
+//
+// The peak memory of the process is reported at the end; compare
+// a default build with a RAYTRACER_FLOAT one (which has its own
+// baseline) to see what single precision saves.
+//
+// Every render is repeated --runs times and the fastest run is
+// kept, which filters out most scheduling noise. The exit code
+// is 1 if any metric is slower than the baseline by more than
+// the tolerance, so the target can be used in CI.
+// ============================================================
+
+#ifndef RAYTRACER_BENCH_BASELINE
+#define RAYTRACER_BENCH_BASELINE "bench/baseline.txt"
+#endif
+
+using bench_clock = std::chrono::steady_clock;
+
+// Milliseconds elapsed since 'start'
+static double elapsed_ms(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+// --------------------------------------
+// Results of one benchmark scene
+// --------------------------------------
+struct bench_result {
+    std::string scene;
+    double parse_ms = 0;    // OBJ parsing (generated mesh only)
+    double build_ms = 0;    // Scene construction + BVH build
+    double render_ms = 0;   // Fastest render over all runs
+    double free_ms = 0;     // Scene and BVH teardown
+    uint64_t rays = 0;      // Rays per render; fixed for a fixed seed
+    size_t primitives = 0;
+
+    double rays_per_second() const { return render_ms > 0 ? rays / (render_ms / 1000.0) : 0; }
+};
+
+// --------------------------------------
+// Benchmark settings shared by all scenes. Small images keep
+// a full run in the range of seconds; the fixed seed makes
+// every run trace exactly the same rays.
+// --------------------------------------
+struct bench_settings {
+    int image_width = 160;
+    int samples_per_pixel = 8;
+    int max_depth = 8;
+    uint64_t seed = 1;
+    int runs = 3;
+    int packet_size = 0;     // Camera render modes under test
+    bool wavefront = false;
+    bool reorder_rays = false;
+    bool specialized = false;
+    int compressed_bits = 0;  // 8 or 16: render through compressed_scene
+    bool arena = false;      // Scene objects from an arena, relocated after the build
+    double paged_cache_mb = 0;  // > 0: terrain scenes as paged meshes with this cache
+    bool lazy = false;       // Deferred BVH subtrees, built by the first rays to enter them
+    accelerator_type accelerator = accelerator_type::bvh;
+    bvh_split_method split_method = bvh_split_method::median;
+    bool sbvh = false;       // Spatial-split builder; overrides split_method and lazy
+};
+
+// --------------------------------------
+// Builds the BVH over 'scene', renders it 'runs' times and
+// fills in the timings. build_ms accumulates on top of any
+// scene construction time already recorded.
+// --------------------------------------
+static void run_scene(bench_result& result, hittable_list& scene, camera& cam,
+                      const bench_settings& settings) {
+    cam.image_width       = settings.image_width;
+    cam.samples_per_pixel = settings.samples_per_pixel;
+    cam.max_depth         = settings.max_depth;
+    cam.seed              = settings.seed;
+    cam.packet_size       = settings.packet_size;
+    cam.wavefront         = settings.wavefront;
+    cam.reorder_rays      = settings.reorder_rays;
+
+    if (settings.sbvh && settings.accelerator == accelerator_type::bvh) {
+        std::clog << result.scene << ":\n";
+        report_spatial_splits(scene);
+    }
+
+    auto build_start = bench_clock::now();
+    accelerator_type accelerator = settings.accelerator;
+    if (accelerator == accelerator_type::automatic) {
+        accelerator = choose_accelerator(scene);
+        std::clog << result.scene << ": " << accelerator_name(accelerator) << "\n";
+    }
+    if (accelerator == accelerator_type::grid) {
+        auto grid = make_scene_object<uniform_grid>(scene);
+        result.primitives = scene.objects.size();
+        result.build_ms += elapsed_ms(build_start);
+        std::clog << result.scene << ": grid of " << grid->cell_count() << " cells ("
+                  << grid->occupied_cells() << " occupied, " << grid->nested_grids() << " nested), "
+                  << grid->unbinned_count() << " primitives outside\n";
+
+        result.render_ms = 0;
+        for (int run = 0; run < settings.runs; run++) {
+            uint64_t rays_before = total_rays_traced();
+            auto render_start = bench_clock::now();
+            cam.render_framebuffer(*grid);
+            double ms = elapsed_ms(render_start);
+            result.rays = total_rays_traced() - rays_before;
+            if (run == 0 || ms < result.render_ms) result.render_ms = ms;
+        }
+
+        auto free_start = bench_clock::now();
+        grid.reset();
+        scene.clear();
+        result.free_ms = elapsed_ms(free_start);
+        return;
+    }
+
+    auto world = settings.sbvh ? make_sbvh(scene)
+               : settings.lazy ? make_lazy_bvh(scene)
+               : make_scene_object<bvh_node>(scene, settings.split_method);
+    shared_ptr<sphere_tri_scene> specialized;
+    shared_ptr<sphere_tri_scene_8> compressed_8;
+    shared_ptr<sphere_tri_scene_16> compressed_16;
+    if (settings.specialized) {
+        specialized = sphere_tri_scene::from_bvh(*world);
+        if (!specialized) std::clog << result.scene << ": not specialized (other hittables)\n";
+    }
+    if (settings.compressed_bits == 8) compressed_8 = sphere_tri_scene_8::from_bvh(*world);
+    if (settings.compressed_bits == 16) compressed_16 = sphere_tri_scene_16::from_bvh(*world);
+    const bool compressed = compressed_8 || compressed_16;
+    if (settings.compressed_bits && !compressed) {
+        std::clog << result.scene << ": not compressed (other hittables)\n";
+    } else if (compressed) {
+        auto flat = sphere_tri_scene::from_bvh(*world);
+        size_t bytes = compressed_8 ? compressed_8->node_bytes() : compressed_16->node_bytes();
+        std::clog << result.scene << ": " << flat->node_count() << " nodes, "
+                  << flat->node_bytes() / 1024.0 << " KB full, " << bytes / 1024.0 << " KB "
+                  << settings.compressed_bits << "-bit\n";
+    }
+    result.primitives = scene.objects.size();
+
+    // Arena mode: the tree is copied in traversal order, and the
+    // load arena goes away with the old tree and the scene list
+    std::optional<scene_arena> layout_arena;
+    if (settings.arena && !specialized && !compressed) {
+        layout_arena.emplace();
+        world = world->relocate(*layout_arena);
+        scene.clear();
+    }
+    result.build_ms += elapsed_ms(build_start);
+
+    result.render_ms = 0;
+    for (int run = 0; run < settings.runs; run++) {
+        uint64_t rays_before = total_rays_traced();
+        auto render_start = bench_clock::now();
+        if (specialized)
+            cam.render_framebuffer(*specialized);
+        else if (compressed_8)
+            cam.render_framebuffer(*compressed_8);
+        else if (compressed_16)
+            cam.render_framebuffer(*compressed_16);
+        else
+            cam.render_framebuffer(*world);
+        double ms = elapsed_ms(render_start);
+
+        result.rays = total_rays_traced() - rays_before;
+        if (run == 0 || ms < result.render_ms) result.render_ms = ms;
+
+        lazy_bvh_progress progress(*world);
+        if (run == 0 && progress.subtrees > 0) {
+            std::clog << result.scene << ": first render " << ms << " ms, built "
+                      << progress.built << " of " << progress.subtrees << " subtrees ("
+                      << progress.built_primitives << " of " << progress.primitives << " primitives)\n";
+        }
+    }
+
+    auto free_start = bench_clock::now();
+    specialized.reset();
+    compressed_8.reset();
+    compressed_16.reset();
+    world.reset();
+    scene.clear();
+    layout_arena.reset();
+    result.free_ms = elapsed_ms(free_start);
+}
+
+// --------------------------------------
+// Moves the turntable instances through a short animation and
+// prints the mean time per frame of bvh_node::refit() against
+// a full rebuild. The instances stay at the last pose.
+// --------------------------------------
+static void report_refit(const std::string& name, const hittable_list& scene,
+                         const std::vector<shared_ptr<instance>>& instances) {
+    const int frames = 24;
+    auto world = make_shared<bvh_node>(scene);
+    double refit_ms = 0, rebuild_ms = 0;
+    for (int frame = 1; frame <= frames; frame++) {
+        turntable_pose(instances, 0.5 * frame);
+
+        auto refit_start = bench_clock::now();
+        world->refit();
+        refit_ms += elapsed_ms(refit_start);
+
+        auto rebuild_start = bench_clock::now();
+        auto rebuilt = make_shared<bvh_node>(scene);
+        rebuild_ms += elapsed_ms(rebuild_start);
+    }
+    std::clog << name << ": " << instances.size() << " instances, refit " << refit_ms / frames
+              << " ms per frame, full build " << rebuild_ms / frames << " ms\n";
+}
+
+// --------------------------------------
+// Renders one benchmark scene by name
+// --------------------------------------
+static bench_result bench_scene(const std::string& name, const bench_settings& settings) {
+    bench_result result;
+    result.scene = name;
+
+    // Scene generators draw random numbers too; start them from the same state
+    seed_random(settings.seed);
+
+    // Generated 200x200 terrain (80,000 triangles) written to disk and
+    // read back, so the OBJ parser is part of the benchmark
+    const std::string mesh_path = "bench_terrain.obj";
+    if (name == "large_mesh" || name == "mesh_cave") write_terrain_obj(mesh_path, 200);
+    const bool paged = settings.paged_cache_mb > 0;
+    const size_t paged_cache_bytes = size_t(settings.paged_cache_mb * 1024 * 1024);
+    shared_ptr<paged_mesh> paged_terrain;
+    std::vector<shared_ptr<instance>> instances;  // turntable only
+
+    // Loaders and builders allocate from the arena while the scope is active
+    std::optional<scene_arena> load_arena;
+    std::optional<arena_scope> scope;
+    if (settings.arena) {
+        load_arena.emplace();
+        scope.emplace(*load_arena);
+    }
+
+    hittable_list scene;
+    camera cam;
+    auto build_start = bench_clock::now();
+
+    if (name == "many_spheres") {
+        many_spheres_scene(scene, cam);
+    } else if (name == "three_spheres") {
+        three_spheres_scene(scene, cam);
+    } else if (name == "tris") {
+        tris_scene(scene, cam);
+    } else if (name == "many_lights") {
+        many_lights_scene(scene, cam, 16);
+    } else if (name == "turntable") {
+        turntable_scene(scene, cam, instances, 250);
+    } else if (name == "skinny_tris") {
+        skinny_tris_scene(scene, cam, 200);
+    } else if (name == "large_mesh" && paged) {
+        large_mesh_camera(cam);
+
+        auto parse_start = bench_clock::now();
+        paged_terrain = load_paged_obj_file(mesh_path, make_shared<lambertian>(color(0.6, 0.55, 0.45)),
+                                            paged_cache_bytes);
+        result.parse_ms = elapsed_ms(parse_start);
+        if (paged_terrain) scene.add(paged_terrain);
+    } else if (name == "large_mesh") {
+        large_mesh_camera(cam);
+
+        auto parse_start = bench_clock::now();
+        load_obj_file(mesh_path, scene, make_shared<lambertian>(color(0.6, 0.55, 0.45)));
+        result.parse_ms = elapsed_ms(parse_start);
+    } else if (name == "mesh_cave") {
+        // The terrain twice (floor and ceiling) through one shared BVH;
+        // nearly all work is in secondary rays
+        // Only loading counts as parsing; the terrain's BVH is build time
+        shared_ptr<hittable> terrain;
+        if (paged) {
+            auto parse_start = bench_clock::now();
+            terrain = paged_terrain = load_paged_obj_file(mesh_path, nullptr, paged_cache_bytes);
+            result.parse_ms = elapsed_ms(parse_start);
+        } else {
+            hittable_list triangles;
+            auto parse_start = bench_clock::now();
+            load_obj_file(mesh_path, triangles, nullptr);
+            result.parse_ms = elapsed_ms(parse_start);
+            if (settings.accelerator != accelerator_type::bvh)
+                terrain = make_accelerator(triangles, settings.accelerator);
+            else
+                terrain = settings.sbvh ? make_sbvh(triangles)
+                        : settings.lazy ? make_lazy_bvh(triangles)
+                        : make_scene_object<bvh_node>(triangles, settings.split_method);
+        }
+        mesh_cave_scene(scene, cam, terrain);
+    } else {
+        std::cerr << "Unknown benchmark scene: " << name << "\n";
+    }
+
+    std::remove(mesh_path.c_str());
+
+    result.build_ms = elapsed_ms(build_start) - result.parse_ms;
+    if (!instances.empty()) report_refit(name, scene, instances);
+    run_scene(result, scene, cam, settings);
+
+    if (paged_terrain) {
+        cluster_cache_stats stats = paged_terrain->cache_statistics();
+        std::clog << name << ": " << paged_terrain->cluster_count() << " clusters, "
+                  << paged_terrain->file_bytes() / (1024.0 * 1024.0) << " MB file, " << stats.misses
+                  << " clusters paged in (" << stats.bytes_paged_in / (1024.0 * 1024.0) << " MB), "
+                  << stats.evictions << " evictions\n";
+    }
+    paged_terrain.reset();  // Unmapped before the file is removed
+    std::remove((mesh_path + ".paged").c_str());
+    return result;
+}
+
+// --------------------------------------
+// Baseline file: one "scene metric value" triple per line
+// --------------------------------------
+using baseline_table = std::map<std::string, std::map<std::string, double>>;
+
+static baseline_table read_baseline(const std::string& filename) {
+    baseline_table table;
+    std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream iss(line);
+        std::string scene, metric;
+        double value;
+        if (iss >> scene >> metric >> value) table[scene][metric] = value;
+    }
+    return table;
+}
+
+// Replaces the entries of the benchmarked scenes; other scenes
+// already in the file keep theirs
+static void write_baseline(const std::string& filename, const std::vector<bench_result>& results,
+                           const bench_settings& settings) {
+    baseline_table table = read_baseline(filename);
+    for (const auto& r : results) {
+        table[r.scene] = { { "parse_ms", r.parse_ms }, { "build_ms", r.build_ms },
+                           { "render_ms", r.render_ms }, { "rays", double(r.rays) } };
+    }
+
+    std::ofstream file(filename);
+    file << "# RayTracerBench baseline: " << settings.image_width << "px wide, "
+         << settings.samples_per_pixel << " spp, depth " << settings.max_depth
+         << ", seed " << settings.seed << "\n";
+    file << "# scene metric value\n";
+    file << std::fixed << std::setprecision(3);
+    for (const auto& [scene, metrics] : table) {
+        for (const char* metric : { "parse_ms", "build_ms", "render_ms" })
+            file << scene << ' ' << metric << ' ' << metrics.at(metric) << "\n";
+        file << scene << " rays " << uint64_t(metrics.at("rays")) << "\n";
+    }
+}
+
+// --------------------------------------
+// Compares one timing against the baseline. Very short phases
+// (under 5 ms) are only reported, never flagged: timer
+// resolution and noise dominate there.
+// --------------------------------------
+static bool check_metric(const std::string& scene, const std::string& metric,
+                         double current, const baseline_table& baseline, double tolerance) {
+    auto scene_it = baseline.find(scene);
+    if (scene_it == baseline.end()) return true;
+    auto metric_it = scene_it->second.find(metric);
+    if (metric_it == scene_it->second.end()) return true;
+
+    double reference = metric_it->second;
+    if (reference == 0 && current == 0) return true;
+
+    double change = reference > 0 ? (current - reference) / reference : 0;
+    bool slower = change > tolerance && std::max(reference, current) >= 5.0;
+
+    std::cout << "  " << std::left << std::setw(10) << metric << std::right
+              << std::setw(10) << reference << " -> " << std::setw(10) << current << " ms  "
+              << std::showpos << std::setw(6) << change * 100 << std::noshowpos << "%"
+              << (slower ? "  SLOWER" : "") << "\n";
+    return !slower;
+}
+
+int main(int argc, char* argv[]) {
+    bench_settings settings;
+    std::string baseline_file = RAYTRACER_BENCH_BASELINE;
+    bool update_baseline = false;
+    double tolerance = 0.15;
+    std::vector<std::string> scenes = { "many_spheres", "three_spheres", "tris",
+                                        "large_mesh", "mesh_cave", "many_lights", "turntable", "skinny_tris" };
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "--update-baseline") {
+            update_baseline = true;
+        } else if (arg == "--baseline" && a + 1 < argc) {
+            baseline_file = argv[++a];
+        } else if (arg == "--tolerance" && a + 1 < argc) {
+            tolerance = std::stod(argv[++a]);
+        } else if (arg == "--runs" && a + 1 < argc) {
+            settings.runs = std::max(1, std::stoi(argv[++a]));
+        } else if (arg == "--scene" && a + 1 < argc) {
+            scenes = { argv[++a] };
+        } else if (arg == "--packets" && a + 1 < argc) {
+            settings.packet_size = std::stoi(argv[++a]);
+        } else if (arg == "--wavefront") {
+            settings.wavefront = true;
+        } else if (arg == "--reorder") {
+            settings.wavefront = settings.reorder_rays = true;
+        } else if (arg == "--specialized") {
+            settings.specialized = true;
+        } else if (arg == "--compressed" && a + 1 < argc) {
+            settings.compressed_bits = std::stoi(argv[++a]) <= 8 ? 8 : 16;
+        } else if (arg == "--arena") {
+            settings.arena = true;
+        } else if (arg == "--paged" && a + 1 < argc) {
+            settings.paged_cache_mb = std::stod(argv[++a]);
+        } else if (arg == "--lazy") {
+            settings.lazy = true;
+        } else if (arg == "--accel" && a + 1 < argc && parse_accelerator(argv[a + 1], settings.accelerator)) {
+            a++;
+        } else if (arg == "--build" && a + 1 < argc && parse_split_method(argv[a + 1], settings.split_method)) {
+            a++;
+        } else if (arg == "--sbvh") {
+            settings.sbvh = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--baseline file] [--update-baseline]"
+                      << " [--tolerance fraction] [--runs n] [--scene name]"
+                      << " [--packets n] [--wavefront] [--reorder] [--specialized] [--compressed 8|16] [--arena] [--paged MB] [--lazy] [--accel bvh|grid|auto]"
+                      << " [--build median|lbvh|lbvh_optimized] [--sbvh]\n";
+            return 2;
+        }
+    }
+
+    std::vector<bench_result> results;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Precision: " << (sizeof(real) == sizeof(float) ? "float" : "double")
+              << (alignof(vector3) > alignof(real) ? ", SIMD vector3" : "")
+              << ", " << (settings.sbvh ? "sbvh" : split_method_name(settings.split_method)) << " BVH build\n";
+    std::cout << std::left << std::setw(14) << "scene" << std::right
+              << std::setw(10) << "prims" << std::setw(11) << "parse ms"
+              << std::setw(11) << "build ms" << std::setw(12) << "render ms"
+              << std::setw(12) << "rays" << std::setw(12) << "Mrays/s"
+              << std::setw(10) << "free ms" << "\n";
+
+    for (const auto& name : scenes) {
+        bench_result r = bench_scene(name, settings);
+        results.push_back(r);
+        std::cout << std::left << std::setw(14) << r.scene << std::right
+                  << std::setw(10) << r.primitives << std::setw(11) << r.parse_ms
+                  << std::setw(11) << r.build_ms << std::setw(12) << r.render_ms
+                  << std::setw(12) << r.rays << std::setw(12) << r.rays_per_second() / 1e6
+                  << std::setw(10) << r.free_ms << "\n";
+    }
+
+    std::cout << "Peak memory: " << peak_rss_kb() / 1024.0 << " MB\n";
+
+    if (update_baseline) {
+        write_baseline(baseline_file, results, settings);
+        std::cout << "Baseline written to " << baseline_file << "\n";
+        return 0;
+    }
+
+    baseline_table baseline = read_baseline(baseline_file);
+    if (baseline.empty()) {
+        std::cout << "No baseline at " << baseline_file << " (run with --update-baseline)\n";
+        return 0;
+    }
+
+    std::cout << "\nCompared with " << baseline_file << " (tolerance "
+              << tolerance * 100 << "%):\n";
+    bool ok = true;
+    for (const auto& r : results) {
+        std::cout << r.scene << "\n";
+        ok &= check_metric(r.scene, "parse_ms",  r.parse_ms,  baseline, tolerance);
+        ok &= check_metric(r.scene, "build_ms",  r.build_ms,  baseline, tolerance);
+        ok &= check_metric(r.scene, "render_ms", r.render_ms, baseline, tolerance);
+
+        // Same seed and settings must trace the same rays; a different
+        // count means the render itself changed, not just its speed
+        auto scene_it = baseline.find(r.scene);
+        if (scene_it != baseline.end() && scene_it->second.count("rays")
+            && uint64_t(scene_it->second.at("rays")) != r.rays) {
+            std::cout << "  note: ray count changed (" << uint64_t(scene_it->second.at("rays"))
+                      << " -> " << r.rays << "); timings are not directly comparable\n";
+        }
+    }
+
+    std::cout << (ok ? "\nNo slowdowns beyond tolerance.\n" : "\nSlowdown detected.\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+#ifndef IMAGE_METRICS_H
+#define IMAGE_METRICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../src/color.h"
+
+// ============================================================
+// Image comparison helpers for the regression harness
+//
+// Images are linear RGB, row-major with the top row first
+// (the camera's framebuffer layout divided by the sample
+// count). References are stored as color PFM files so they
+// keep full precision.
+// ============================================================
+struct image {
+    int width = 0;
+    int height = 0;
+    std::vector<color> pixels;
+
+    const color& at(int i, int j) const { return pixels[size_t(j) * width + i]; }
+};
+
+// --------------------------------------
+// write_pfm(filename, img) / read_pfm(filename, img)
+// Color Portable Float Map ("PF"): rows bottom-to-top,
+// little-endian 32-bit floats (negative scale)
+// --------------------------------------
+inline bool write_pfm(const std::string& filename, const image& img) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) return false;
+    file << "PF\n" << img.width << ' ' << img.height << "\n-1.0\n";
+    for (int j = img.height - 1; j >= 0; j--) {
+        for (int i = 0; i < img.width; i++) {
+            const color& c = img.at(i, j);
+            float rgb[3] = { float(c.x()), float(c.y()), float(c.z()) };
+            file.write(reinterpret_cast<const char*>(rgb), sizeof(rgb));
+        }
+    }
+    return bool(file);
+}
+
+inline bool read_pfm(const std::string& filename, image& img) {
+    std::ifstream file(filename, std::ios::binary);
+    std::string magic;
+    double scale;
+    if (!(file >> magic >> img.width >> img.height >> scale) || magic != "PF" || scale >= 0)
+        return false;
+    file.get();  // Single whitespace before the data
+
+    img.pixels.assign(size_t(img.width) * img.height, color());
+    for (int j = img.height - 1; j >= 0; j--) {
+        for (int i = 0; i < img.width; i++) {
+            float rgb[3];
+            if (!file.read(reinterpret_cast<char*>(rgb), sizeof(rgb))) return false;
+            img.pixels[size_t(j) * img.width + i] = color(rgb[0], rgb[1], rgb[2]);
+        }
+    }
+    return true;
+}
+
+// Clamps to the displayable range [0,1], like write_color does
+inline color display_clamp(const color& c) {
+    return color(std::clamp<real>(c.x(), 0, 1), std::clamp<real>(c.y(), 0, 1), std::clamp<real>(c.z(), 0, 1));
+}
+
+inline double luminance(const color& c) {
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+// --------------------------------------
+// rmse(a, b)
+// Root-mean-square error over all channels of the display-
+// clamped images, so single fireflies above 1 do not dominate
+// --------------------------------------
+inline double rmse(const image& a, const image& b) {
+    double sum = 0;
+    for (size_t k = 0; k < a.pixels.size(); k++) {
+        color d = display_clamp(a.pixels[k]) - display_clamp(b.pixels[k]);
+        sum += d.length_squared();
+    }
+    return std::sqrt(sum / (3.0 * double(a.pixels.size())));
+}
+
+// Linear RGB (sRGB primaries, D65) to CIE L*a*b*
+inline color linear_to_lab(const color& c) {
+    double x = (0.4124 * c.x() + 0.3576 * c.y() + 0.1805 * c.z()) / 0.95047;
+    double y =  0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+    double z = (0.0193 * c.x() + 0.1192 * c.y() + 0.9505 * c.z()) / 1.08883;
+
+    auto f = [](double t) { return t > 0.008856 ? std::cbrt(t) : 7.787 * t + 16.0 / 116.0; };
+    double fx = f(x), fy = f(y), fz = f(z);
+    return color(116 * fy - 16, 500 * (fx - fy), 200 * (fy - fz));
+}
+
+// --------------------------------------
+// flip_error(reference, test)
+// A simplified FLIP-style perceptual difference in [0,1]
+// (mean over pixels). Like FLIP it combines:
+//  - a color term: HyAB distance between the two images in
+//    L*a*b* after a small Gaussian blur (standing in for the
+//    contrast sensitivity filter), remapped so that errors
+//    near the visibility threshold count the most
+//  - a feature term: difference in luminance edge strength
+//    (Sobel), which amplifies the color error where edges
+//    appear or disappear
+// It is not calibrated against the real FLIP, but it ranks
+// noise, blur and color shifts in the same way.
+// --------------------------------------
+inline double flip_error(const image& reference, const image& test) {
+    const int w = reference.width, h = reference.height;
+
+    auto filtered_lab = [w, h](const image& img) {
+        static const double kernel[3] = { 0.25, 0.5, 0.25 };
+        std::vector<color> lab(img.pixels.size());
+        for (int j = 0; j < h; j++) {
+            for (int i = 0; i < w; i++) {
+                color sum(0, 0, 0);
+                for (int dj = -1; dj <= 1; dj++)
+                    for (int di = -1; di <= 1; di++) {
+                        int x = std::clamp(i + di, 0, w - 1), y = std::clamp(j + dj, 0, h - 1);
+                        sum += kernel[di + 1] * kernel[dj + 1] * display_clamp(img.at(x, y));
+                    }
+                lab[size_t(j) * w + i] = linear_to_lab(sum);
+            }
+        }
+        return lab;
+    };
+
+    auto edge_strength = [w, h](const image& img) {
+        std::vector<double> edges(img.pixels.size());
+        auto L = [&](int i, int j) {
+            return luminance(display_clamp(img.at(std::clamp(i, 0, w - 1), std::clamp(j, 0, h - 1))));
+        };
+        for (int j = 0; j < h; j++) {
+            for (int i = 0; i < w; i++) {
+                double gx = (L(i+1,j-1) + 2*L(i+1,j) + L(i+1,j+1)) - (L(i-1,j-1) + 2*L(i-1,j) + L(i-1,j+1));
+                double gy = (L(i-1,j+1) + 2*L(i,j+1) + L(i+1,j+1)) - (L(i-1,j-1) + 2*L(i,j-1) + L(i+1,j-1));
+                edges[size_t(j) * w + i] = std::sqrt(gx * gx + gy * gy) / 4.0;
+            }
+        }
+        return edges;
+    };
+
+    auto hyab = [](const color& a, const color& b) {
+        double da = a.y() - b.y(), db = a.z() - b.z();
+        return std::fabs(a.x() - b.x()) + std::sqrt(da * da + db * db);
+    };
+
+    // Largest color distance (green vs blue), mapped like FLIP with
+    // threshold pc and the fraction pt of the error range below it
+    const double exponent = 0.7, pc = 0.4, pt = 0.95;
+    const double cmax = std::pow(hyab(linear_to_lab(color(0, 1, 0)), linear_to_lab(color(0, 0, 1))), exponent);
+
+    std::vector<color> lab_ref = filtered_lab(reference), lab_test = filtered_lab(test);
+    std::vector<double> edge_ref = edge_strength(reference), edge_test = edge_strength(test);
+
+    double total = 0;
+    for (size_t k = 0; k < lab_ref.size(); k++) {
+        double d = std::pow(hyab(lab_ref[k], lab_test[k]), exponent);
+        double color_error = d < pc * cmax
+            ? pt / (pc * cmax) * d
+            : pt + (d - pc * cmax) / (cmax - pc * cmax) * (1 - pt);
+        color_error = std::min(color_error, 1.0);
+
+        double feature_error = std::min(1.0, std::fabs(edge_ref[k] - edge_test[k]) / std::sqrt(2.0));
+        total += std::pow(color_error, 1.0 - feature_error);
+    }
+    return total / double(lab_ref.size());
+}
+
+#endif // IMAGE_METRICS_H
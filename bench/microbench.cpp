@@ -0,0 +1,365 @@
+#include "../src/ray_tracer.h"
+
+#include "../src/bvh.h"
+#include "../src/camera.h"
+#include "../src/compressed_scene.h"
+#include "../src/hittable_list.h"
+#include "../src/input.h"
+#include "../src/scenes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// ============================================================
+// RayTracerMicrobench
+//
+// Times the intersection kernels in isolation, away from the
+// noise of full renders:
+//  - sphere::hit, tri::hit and aabb::hit, each ray tested
+//    against a fixed set of primitives or boxes
+//  - bvh_node::hit on a two-primitive node (node overhead)
+//  - whole-BVH traversal of a sphere scene and a terrain mesh,
+//    ray by ray and (coherent rays only) as 8x8 packets
+//  - the same traversal through the flat static_scene and its
+//    8- and 16-bit quantized variants (compressed_scene), with
+//    the size of each node array
+//
+// Every kernel runs on two pre-generated ray batches:
+//  - coherent:   primary rays of a pinhole camera, in scanline order
+//  - incoherent: bounce rays leaving the primary hit points in
+//                random directions, shuffled
+//
+// Usage: RayTracerMicrobench [--threads n] [--repeats n] [--terrain n]
+//
+// --terrain sets the terrain resolution (n x n quads, 200 by
+// default); at 700 (980k triangles) its tree no longer fits in
+// cache and traversal becomes bound by memory.
+//
+// Each thread is pinned to its own core and makes one untimed
+// pass over the batch (to warm caches and branch predictors)
+// before the timed passes; the fastest pass is reported. With
+// several threads, every thread runs the same kernel at once
+// and the per-core numbers are averaged.
+// ============================================================
+
+using bench_clock = std::chrono::steady_clock;
+
+// Pins the calling thread to one core (no-op where unsupported)
+static void pin_to_core(int core) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    core = int(unsigned(core) % cores);
+#ifdef _WIN32
+    SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)core;
+#endif
+}
+
+// --------------------------------------
+// Ray batch generation
+// --------------------------------------
+
+// Primary rays through the pixel centers of a width x height
+// image seen from the scene camera, in scanline order
+static std::vector<ray> coherent_rays(const camera& cam, int width, int height) {
+    vector3 w = (cam.lookfrom - cam.lookat).normalize();
+    vector3 u = cross(cam.vup, w).normalize();
+    vector3 v = cross(w, u);
+    double half_h = std::tan(degrees_to_radians(cam.vfov) / 2);
+    double half_w = half_h * double(width) / height;
+
+    std::vector<ray> rays;
+    rays.reserve(size_t(width) * height);
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i++) {
+            double s = (2.0 * (i + 0.5) / width - 1.0) * half_w;
+            double t = (1.0 - 2.0 * (j + 0.5) / height) * half_h;
+            rays.emplace_back(cam.lookfrom, s * u + t * v - w);
+        }
+    }
+    return rays;
+}
+
+// Bounce rays: for every primary ray that hits the scene, a ray
+// leaving the hit point in a random direction of the hemisphere
+// around the normal. Shuffled so consecutive rays are unrelated.
+static std::vector<ray> incoherent_rays(const std::vector<ray>& primary, const hittable& world) {
+    std::vector<ray> rays;
+    for (const ray& r : primary) {
+        hit_record rec;
+        if (world.hit(r, interval(0.001, infinity), rec))
+            rays.emplace_back(rec.p, random_on_hemisphere(rec.normal));
+    }
+    for (size_t k = rays.size(); k > 1; k--)
+        std::swap(rays[k - 1], rays[size_t(random_int(0, int(k) - 1))]);
+    return rays;
+}
+
+// --------------------------------------
+// Timing
+// --------------------------------------
+struct kernel_timing {
+    double ns_per_item = 0;  // Per ray (or per ray-primitive test)
+    uint64_t hits = 0;       // Hits of one pass, so results can be sanity-checked
+};
+
+// --------------------------------------
+// Runs 'pass' (one sweep over a batch, returning the hit count)
+// on 'threads' pinned threads: one warm-up pass, then 'repeats'
+// timed passes. Returns the fastest pass per item, averaged
+// over the threads.
+// --------------------------------------
+static kernel_timing time_kernel(const std::function<uint64_t()>& pass, size_t items,
+                                 int threads, int repeats) {
+    std::vector<double> best(threads, 0);
+    std::vector<uint64_t> hits(threads, 0);
+    std::atomic<int> ready{0};
+
+    auto worker = [&](int t) {
+        pin_to_core(t);
+        hits[t] = pass();  // Warm-up
+
+        // Start the timed passes together so threads compete as in a render
+        ready++;
+        while (ready < threads) std::this_thread::yield();
+
+        for (int rep = 0; rep < repeats; rep++) {
+            auto start = bench_clock::now();
+            hits[t] = pass();
+            double ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+            if (rep == 0 || ns < best[t]) best[t] = ns;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) pool.emplace_back(worker, t);
+    for (auto& thread : pool) thread.join();
+
+    kernel_timing timing;
+    for (int t = 0; t < threads; t++) timing.ns_per_item += best[t] / double(items) / threads;
+    timing.hits = hits[0];
+    return timing;
+}
+
+static void report(const std::string& kernel, const std::string& batch, size_t rays,
+                   const kernel_timing& timing, const std::string& unit = "ray") {
+    std::cout << std::left << std::setw(30) << kernel << std::setw(12) << batch << std::right
+              << std::setw(10) << rays << std::setw(10) << timing.ns_per_item << " ns/" << std::left
+              << std::setw(6) << unit << std::right << std::setw(10) << 1000.0 / timing.ns_per_item
+              << "   " << timing.hits << "\n";
+}
+
+// --------------------------------------
+// Kernel passes. Each takes a batch and returns the number of
+// hits, which keeps the compiler from discarding the work.
+// --------------------------------------
+
+// Every ray against every primitive in 'prims'
+static uint64_t primitive_pass(const std::vector<ray>& rays, const std::vector<shared_ptr<hittable>>& prims) {
+    uint64_t hits = 0;
+    hit_record rec;
+    for (const ray& r : rays)
+        for (const auto& prim : prims)
+            hits += prim->hit(r, interval(0.001, infinity), rec);
+    return hits;
+}
+
+// Every ray against every box in 'boxes'
+static uint64_t box_pass(const std::vector<ray>& rays, const std::vector<aabb>& boxes) {
+    uint64_t hits = 0;
+    for (const ray& r : rays)
+        for (const aabb& box : boxes)
+            hits += box.hit(r, interval(0.001, infinity));
+    return hits;
+}
+
+// Every ray against one hittable (BVH node or whole tree)
+static uint64_t traversal_pass(const std::vector<ray>& rays, const hittable& world) {
+    uint64_t hits = 0;
+    hit_record rec;
+    for (const ray& r : rays)
+        hits += world.hit(r, interval(0.001, infinity), rec);
+    return hits;
+}
+
+// Coherent rays (scanline order, 'width' per row) traced as
+// 8x8 packets against the whole BVH
+static uint64_t packet_pass(const std::vector<ray>& rays, int width, const hittable& world) {
+    int height = int(rays.size()) / width;
+    uint64_t hits = 0;
+    ray_packet packet;
+    int active[ray_packet::max_size];
+    for (int k = 0; k < ray_packet::max_size; k++) active[k] = k;
+
+    for (int y0 = 0; y0 < height; y0 += 8) {
+        for (int x0 = 0; x0 < width; x0 += 8) {
+            packet.clear();
+            for (int y = y0; y < std::min(y0 + 8, height); y++)
+                for (int x = x0; x < std::min(x0 + 8, width); x++)
+                    packet.add(rays[size_t(y) * width + x]);
+            packet.finalize();
+            world.hit_packet(packet, interval(0.001, infinity), active, packet.size);
+            for (int k = 0; k < packet.size; k++) hits += packet.hit[k];
+        }
+    }
+    return hits;
+}
+
+// --------------------------------------
+// Benchmarks one scene: primitive kernels on the
+// 'sample_size' primitives nearest the camera target, a two-primitive bvh_node, and
+// traversal of the whole BVH, each on both ray batches
+// --------------------------------------
+static void bench_scene(const std::string& name, hittable_list& scene, const camera& cam,
+                        const std::string& primitive_kernel, int threads, int repeats) {
+    const size_t sample_size = 64;
+
+    auto world = make_shared<bvh_node>(scene);
+    const int batch_width = 256, batch_height = 144;
+    std::vector<ray> coherent = coherent_rays(cam, batch_width, batch_height);
+    std::vector<ray> incoherent = incoherent_rays(coherent, *world);
+
+    // Primitive kernels use every 8th ray: rays x 64 tests is plenty
+    auto every_eighth = [](const std::vector<ray>& rays) {
+        std::vector<ray> part;
+        for (size_t k = 0; k < rays.size(); k += 8) part.push_back(rays[k]);
+        return part;
+    };
+    std::vector<ray> coherent_short = every_eighth(coherent);
+    std::vector<ray> incoherent_short = every_eighth(incoherent);
+
+    // The primitives closest to the center of view, so some rays hit them
+    std::vector<shared_ptr<hittable>> prims(scene.objects);
+    auto distance_to_view = [&cam](const shared_ptr<hittable>& prim) {
+        aabb box = prim->bounding_box();
+        vector3 center(box.x.min + box.x.size() / 2, box.y.min + box.y.size() / 2,
+                       box.z.min + box.z.size() / 2);
+        return (center - cam.lookat).length_squared();
+    };
+    size_t count = std::min(sample_size, prims.size());
+    std::partial_sort(prims.begin(), prims.begin() + count, prims.end(),
+                      [&](const auto& a, const auto& b) { return distance_to_view(a) < distance_to_view(b); });
+    prims.resize(count);
+
+    std::vector<aabb> boxes;
+    for (const auto& prim : prims) boxes.push_back(prim->bounding_box());
+    hittable_list pair_list;
+    pair_list.add(prims[0]);
+    pair_list.add(prims[1]);
+    bvh_node pair_node(pair_list);
+
+    // Flat trees, full and with quantized bounds (spheres and triangles only)
+    auto flat = sphere_tri_scene::from_bvh(*world);
+    auto flat_16 = sphere_tri_scene_16::from_bvh(*world);
+    auto flat_8 = sphere_tri_scene_8::from_bvh(*world);
+
+    std::cout << "\n" << name << ": " << scene.objects.size() << " primitives, "
+              << coherent.size() << " coherent / " << incoherent.size() << " incoherent rays\n";
+    if (flat) {
+        std::cout << "nodes: " << flat->node_count() << ", " << flat->node_bytes() / 1024 << " KB full, "
+                  << flat_16->node_bytes() / 1024 << " KB 16-bit, " << flat_8->node_bytes() / 1024
+                  << " KB 8-bit\n";
+    }
+
+    struct batch { const char* label; const std::vector<ray>* all; const std::vector<ray>* part; };
+    for (const batch& b : { batch{"coherent", &coherent, &coherent_short},
+                            batch{"incoherent", &incoherent, &incoherent_short} }) {
+        size_t tests = b.part->size() * prims.size();
+
+        report(primitive_kernel, b.label, b.part->size(),
+               time_kernel([&] { return primitive_pass(*b.part, prims); }, tests, threads, repeats),
+               "test");
+        report("aabb::hit", b.label, b.part->size(),
+               time_kernel([&] { return box_pass(*b.part, boxes); }, tests, threads, repeats),
+               "test");
+        report("bvh_node::hit (2 prims)", b.label, b.all->size(),
+               time_kernel([&] { return traversal_pass(*b.all, pair_node); }, b.all->size(),
+                           threads, repeats));
+        report("BVH traversal", b.label, b.all->size(),
+               time_kernel([&] { return traversal_pass(*b.all, *world); }, b.all->size(),
+                           threads, repeats));
+        if (flat) {
+            report("static_scene traversal", b.label, b.all->size(),
+                   time_kernel([&] { return traversal_pass(*b.all, *flat); }, b.all->size(),
+                               threads, repeats));
+            report("compressed 16-bit traversal", b.label, b.all->size(),
+                   time_kernel([&] { return traversal_pass(*b.all, *flat_16); }, b.all->size(),
+                               threads, repeats));
+            report("compressed 8-bit traversal", b.label, b.all->size(),
+                   time_kernel([&] { return traversal_pass(*b.all, *flat_8); }, b.all->size(),
+                               threads, repeats));
+        }
+    }
+
+    report("BVH traversal (8x8 packets)", "coherent", coherent.size(),
+           time_kernel([&] { return packet_pass(coherent, batch_width, *world); }, coherent.size(),
+                       threads, repeats));
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 1;
+    int repeats = 5;
+    int terrain_size = 200;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "--threads" && a + 1 < argc) {
+            threads = std::max(1, std::stoi(argv[++a]));
+        } else if (arg == "--repeats" && a + 1 < argc) {
+            repeats = std::max(1, std::stoi(argv[++a]));
+        } else if (arg == "--terrain" && a + 1 < argc) {
+            terrain_size = std::max(2, std::stoi(argv[++a]));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--threads n] [--repeats n] [--terrain n]\n";
+            return 2;
+        }
+    }
+
+    // Fixed seed: the same scenes and ray batches on every run
+    seed_random(1);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << threads << " pinned thread(s), best of " << repeats << " passes after warm-up\n";
+    std::cout << std::left << std::setw(30) << "kernel" << std::setw(12) << "batch" << std::right
+              << std::setw(10) << "rays" << std::setw(20) << "time" << std::setw(10) << "M/s/core"
+              << "   hits\n";
+
+    {
+        hittable_list scene;
+        camera cam;
+        many_spheres_scene(scene, cam);
+        bench_scene("many_spheres", scene, cam, "sphere::hit", threads, repeats);
+    }
+    {
+        const std::string path = "microbench_terrain.obj";
+        write_terrain_obj(path, terrain_size);
+        hittable_list scene;
+        camera cam;
+        large_mesh_camera(cam);
+        load_obj_file(path, scene, make_shared<lambertian>(color(0.6, 0.55, 0.45)));
+        std::remove(path.c_str());
+        bench_scene("large_mesh", scene, cam, "tri::hit", threads, repeats);
+    }
+}
@@ -0,0 +1,378 @@
+#include "../src/ray_tracer.h"
+
+#include "../src/accelerator.h"
+#include "../src/bvh.h"
+#include "../src/camera.h"
+#include "../src/compressed_scene.h"
+#include "../src/hittable_list.h"
+#include "../src/input.h"
+#include "../src/lazy_bvh.h"
+#include "../src/sbvh.h"
+#include "../src/scenes.h"
+#include "../src/static_scene.h"
+#include "image_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ============================================================
+// RayTracerRegress
+//
+// Image regression harness. Renders the built-in scenes at a
+// small size with fixed seeds and compares them with stored
+// high-spp references (bench/references/<scene>.pfm). The
+// turntable scene is rendered after its instances have moved
+// and the BVH was refit (bvh_node::refit()):
+//
+//  - RMSE and a FLIP-style perceptual error of the seed-1
+//    render against the reference, checked against per-scene
+//    tolerances (bench/references/tolerances.txt)
+//  - a bias check: the mean of several independently seeded
+//    renders must agree with the reference within its own
+//    noise, globally and in each of 4x4 image tiles
+//
+// The tolerances are statistical rather than exact: when the
+// references are recorded, the test renders of every seed are
+// measured and the worst one (plus a margin) becomes the limit.
+// A new RNG, sampler or Russian roulette scheme changes the
+// noise pattern like a different seed would and still passes;
+// a change that shifts the expected value fails the bias check
+// even when it looks fine by eye.
+//
+// Usage: RayTracerRegress [--update-references] [--scene name]
+//                         [--reference-spp n] [--packets 4|8] [--wavefront]
+//                         [--reorder] [--specialized] [--lazy]
+//                         [--compressed 8|16] [--accel bvh|grid|auto]
+//                         [--build median|lbvh|lbvh_optimized] [--sbvh]
+//
+// --packets, --wavefront, --reorder and --specialized (static_scene
+// instead of bvh_node) check the camera's other render
+// modes against the same references. --lazy, --compressed and
+// --accel do the same for a lazily built BVH (lazy_bvh.h), a
+// quantized compressed_scene and the accelerator of
+// make_accelerator(); --build and --sbvh for the linear and
+// spatial-split BVH builders. Exit code 1 if any scene fails.
+// ============================================================
+
+#ifndef RAYTRACER_REFERENCE_DIR
+#define RAYTRACER_REFERENCE_DIR "bench/references"
+#endif
+
+// --------------------------------------
+// Harness settings
+// --------------------------------------
+struct regression_settings {
+    int image_width = 80;
+    int max_depth = 10;        // Cap; scenes with a smaller depth keep theirs
+    int test_spp = 16;
+    int reference_spp = 2048;
+    int seeds = 8;             // Independent renders for the bias check
+    uint64_t reference_seed = 1000;
+    double tolerance_margin = 1.25;
+    double bias_z_limit = 5.0; // Standard errors before a difference counts as bias
+    int packet_size = 0;       // Camera render mode under test
+    bool wavefront = false;
+    bool reorder_rays = false;
+    bool specialized = false;
+    bool lazy = false;
+    int compressed_bits = 0;   // 8 or 16: compressed_scene bounds
+    accelerator_type accelerator = accelerator_type::bvh;
+    bvh_split_method split_method = bvh_split_method::median;
+    bool sbvh = false;
+};
+
+// --------------------------------------
+// A scene ready to render: BVH and camera
+// --------------------------------------
+struct regression_scene {
+    std::string name;
+    shared_ptr<bvh_node> world;
+    shared_ptr<sphere_tri_scene> specialized;  // Set with --specialized
+    shared_ptr<sphere_tri_scene_8> compressed_8;   // Set with --compressed 8
+    shared_ptr<sphere_tri_scene_16> compressed_16; // Set with --compressed 16
+    shared_ptr<hittable> accelerator;              // Set with --accel grid|auto
+    camera cam;
+};
+
+static regression_scene build_scene(const std::string& name, const regression_settings& settings) {
+    regression_scene result;
+    result.name = name;
+
+    seed_random(1);  // Scene generators draw random numbers
+    hittable_list scene;
+    camera& cam = result.cam;
+    std::vector<shared_ptr<instance>> instances;  // turntable only
+
+    if (name == "many_spheres") {
+        many_spheres_scene(scene, cam);
+    } else if (name == "three_spheres") {
+        three_spheres_scene(scene, cam);
+    } else if (name == "tris") {
+        tris_scene(scene, cam);
+    } else if (name == "many_lights") {
+        many_lights_scene(scene, cam);
+    } else if (name == "turntable") {
+        turntable_scene(scene, cam, instances);
+    } else if (name == "skinny_tris") {
+        skinny_tris_scene(scene, cam);
+    } else if (name == "large_mesh") {
+        const std::string path = "regression_terrain.obj";
+        write_terrain_obj(path, 100);
+        large_mesh_camera(cam);
+        load_obj_file(path, scene, make_shared<lambertian>(color(0.6, 0.55, 0.45)));
+        std::remove(path.c_str());
+    }
+
+    cam.image_width = settings.image_width;
+    cam.max_depth = std::min(cam.max_depth, settings.max_depth);
+    cam.packet_size = settings.packet_size;
+    cam.wavefront = settings.wavefront;
+    cam.reorder_rays = settings.reorder_rays;
+    result.world = settings.sbvh ? make_sbvh(scene)
+                 : settings.lazy ? make_lazy_bvh(scene)
+                 : make_shared<bvh_node>(scene, settings.split_method);
+    if (!instances.empty()) {
+        turntable_pose(instances, 100);
+        result.world->refit();
+    }
+    if (settings.specialized) result.specialized = sphere_tri_scene::from_bvh(*result.world);
+    if (settings.compressed_bits == 8) result.compressed_8 = sphere_tri_scene_8::from_bvh(*result.world);
+    if (settings.compressed_bits == 16) result.compressed_16 = sphere_tri_scene_16::from_bvh(*result.world);
+    if (settings.accelerator != accelerator_type::bvh)
+        result.accelerator = make_accelerator(scene, settings.accelerator);
+    return result;
+}
+
+// Renders 'scene' with the given sample count and seed (averaged, linear RGB)
+static image render(regression_scene& scene, int spp, uint64_t seed) {
+    scene.cam.samples_per_pixel = spp;
+    scene.cam.seed = seed;
+    std::vector<color> framebuffer;
+    if (scene.specialized)
+        framebuffer = scene.cam.render_framebuffer(*scene.specialized);
+    else if (scene.compressed_8)
+        framebuffer = scene.cam.render_framebuffer(*scene.compressed_8);
+    else if (scene.compressed_16)
+        framebuffer = scene.cam.render_framebuffer(*scene.compressed_16);
+    else if (scene.accelerator)
+        framebuffer = scene.cam.render_framebuffer(*scene.accelerator);
+    else
+        framebuffer = scene.cam.render_framebuffer(*scene.world);
+
+    image img;
+    img.width = scene.cam.image_width;
+    img.height = int(framebuffer.size()) / img.width;
+    img.pixels.reserve(framebuffer.size());
+    for (const color& sum : framebuffer) img.pixels.push_back(sum / spp);
+    return img;
+}
+
+// --------------------------------------
+// Tolerances file: "scene max_rmse max_flip reference_spp"
+// --------------------------------------
+struct scene_tolerance {
+    double rmse = 0;
+    double flip = 0;
+    int reference_spp = 0;
+};
+
+static std::map<std::string, scene_tolerance> read_tolerances(const std::string& filename) {
+    std::map<std::string, scene_tolerance> table;
+    std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream iss(line);
+        std::string scene;
+        scene_tolerance tol;
+        if (iss >> scene >> tol.rmse >> tol.flip >> tol.reference_spp) table[scene] = tol;
+    }
+    return table;
+}
+
+static void write_tolerances(const std::string& filename,
+                             const std::map<std::string, scene_tolerance>& table) {
+    std::ofstream file(filename);
+    file << "# RayTracerRegress tolerances (written by --update-references; may be edited)\n";
+    file << "# scene max_rmse max_flip reference_spp\n";
+    for (const auto& [scene, tol] : table)
+        file << scene << ' ' << tol.rmse << ' ' << tol.flip << ' ' << tol.reference_spp << "\n";
+}
+
+// --------------------------------------
+// bias_check(renders, reference, ...)
+// Compares the mean luminance of independently seeded renders
+// with the reference, over the whole image and in 4x4 tiles.
+// For each region the spread of the per-seed means gives the
+// standard error, widened by the reference's own (smaller)
+// noise. Returns the largest |z| score.
+// --------------------------------------
+static double bias_check(const std::vector<image>& renders, const image& reference,
+                         int test_spp, int reference_spp, std::string& worst_region) {
+    const int tiles = 4;
+    const int w = reference.width, h = reference.height;
+    double worst = 0;
+
+    auto region_mean = [](const image& img, int x0, int y0, int x1, int y1) {
+        double sum = 0;
+        for (int j = y0; j < y1; j++)
+            for (int i = x0; i < x1; i++) sum += luminance(img.at(i, j));
+        return sum / (double(x1 - x0) * (y1 - y0));
+    };
+
+    auto check_region = [&](int x0, int y0, int x1, int y1, const std::string& label) {
+        size_t n = renders.size();
+        std::vector<double> means;
+        for (const image& img : renders) means.push_back(region_mean(img, x0, y0, x1, y1));
+
+        double mean = 0;
+        for (double m : means) mean += m;
+        mean /= n;
+        double variance = 0;
+        for (double m : means) variance += (m - mean) * (m - mean);
+        variance /= (n - 1);
+
+        double target = region_mean(reference, x0, y0, x1, y1);
+        double standard_error = std::sqrt(variance / n + variance * test_spp / reference_spp);
+        standard_error = std::max(standard_error, 1e-5 * std::fabs(target) + 1e-7);  // float storage
+
+        double z = std::fabs(mean - target) / standard_error;
+        if (z > worst) {
+            worst = z;
+            worst_region = label;
+        }
+    };
+
+    check_region(0, 0, w, h, "image");
+    for (int ty = 0; ty < tiles; ty++)
+        for (int tx = 0; tx < tiles; tx++)
+            check_region(tx * w / tiles, ty * h / tiles, (tx + 1) * w / tiles, (ty + 1) * h / tiles,
+                         "tile " + std::to_string(tx) + "," + std::to_string(ty));
+    return worst;
+}
+
+int main(int argc, char* argv[]) {
+    regression_settings settings;
+    std::string reference_dir = RAYTRACER_REFERENCE_DIR;
+    bool update = false;
+    std::vector<std::string> scenes = { "many_spheres", "three_spheres", "tris",
+                                        "many_lights", "large_mesh", "turntable",
+                                        "skinny_tris" };
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "--update-references") {
+            update = true;
+        } else if (arg == "--scene" && a + 1 < argc) {
+            scenes = { argv[++a] };
+        } else if (arg == "--reference-spp" && a + 1 < argc) {
+            settings.reference_spp = std::max(1, std::stoi(argv[++a]));
+        } else if (arg == "--packets" && a + 1 < argc) {
+            settings.packet_size = std::stoi(argv[++a]);
+        } else if (arg == "--wavefront") {
+            settings.wavefront = true;
+        } else if (arg == "--reorder") {
+            settings.wavefront = settings.reorder_rays = true;
+        } else if (arg == "--specialized") {
+            settings.specialized = true;
+        } else if (arg == "--lazy") {
+            settings.lazy = true;
+        } else if (arg == "--compressed" && a + 1 < argc) {
+            settings.compressed_bits = std::stoi(argv[++a]);
+            if (settings.compressed_bits != 8 && settings.compressed_bits != 16) {
+                std::cerr << "--compressed takes 8 or 16\n";
+                return 2;
+            }
+        } else if (arg == "--accel" && a + 1 < argc) {
+            if (!parse_accelerator(argv[++a], settings.accelerator)) {
+                std::cerr << "--accel takes bvh, grid or auto\n";
+                return 2;
+            }
+        } else if (arg == "--build" && a + 1 < argc) {
+            if (!parse_split_method(argv[++a], settings.split_method)) {
+                std::cerr << "--build takes median, lbvh or lbvh_optimized\n";
+                return 2;
+            }
+        } else if (arg == "--sbvh") {
+            settings.sbvh = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--update-references] [--scene name]"
+                      << " [--reference-spp n] [--packets n] [--wavefront] [--reorder]"
+                      << " [--specialized] [--lazy] [--compressed 8|16]"
+                      << " [--accel bvh|grid|auto] [--build median|lbvh|lbvh_optimized]"
+                      << " [--sbvh]\n";
+            return 2;
+        }
+    }
+
+    const std::string tolerance_file = reference_dir + "/tolerances.txt";
+    auto tolerances = read_tolerances(tolerance_file);
+    bool ok = true;
+
+    std::cout << std::fixed << std::setprecision(4);
+    for (const auto& name : scenes) {
+        regression_scene scene = build_scene(name, settings);
+        const std::string reference_file = reference_dir + "/" + name + ".pfm";
+
+        image reference;
+        if (update) {
+            std::clog << "Rendering reference for " << name << " at "
+                      << settings.reference_spp << " spp...\n";
+            reference = render(scene, settings.reference_spp, settings.reference_seed);
+            write_pfm(reference_file, reference);
+        } else if (!read_pfm(reference_file, reference) || !tolerances.count(name)) {
+            std::cout << name << ": no reference (run with --update-references)\n";
+            ok = false;
+            continue;
+        }
+
+        std::vector<image> renders;
+        double worst_rmse = 0, worst_flip = 0;
+        for (int s = 1; s <= settings.seeds; s++) {
+            renders.push_back(render(scene, settings.test_spp, uint64_t(s)));
+            worst_rmse = std::max(worst_rmse, rmse(renders.back(), reference));
+            worst_flip = std::max(worst_flip, flip_error(reference, renders.back()));
+        }
+
+        if (update) {
+            tolerances[name] = { worst_rmse * settings.tolerance_margin,
+                                 worst_flip * settings.tolerance_margin, settings.reference_spp };
+            std::cout << name << ": reference written, tolerance rmse " << tolerances[name].rmse
+                      << ", flip " << tolerances[name].flip << "\n";
+            continue;
+        }
+
+        const scene_tolerance& tol = tolerances[name];
+        double error = rmse(renders[0], reference);
+        double flip = flip_error(reference, renders[0]);
+        std::string worst_region;
+        double z = bias_check(renders, reference, settings.test_spp, tol.reference_spp, worst_region);
+
+        bool pass_rmse = error <= tol.rmse;
+        bool pass_flip = flip <= tol.flip;
+        bool pass_bias = z <= settings.bias_z_limit;
+        ok &= pass_rmse && pass_flip && pass_bias;
+
+        std::cout << std::left << std::setw(14) << name << std::right
+                  << "rmse " << error << " (max " << tol.rmse << ")" << (pass_rmse ? "" : " FAIL")
+                  << "   flip " << flip << " (max " << tol.flip << ")" << (pass_flip ? "" : " FAIL")
+                  << "   bias z " << std::setprecision(2) << z << " at " << worst_region
+                  << (pass_bias ? "" : " FAIL") << std::setprecision(4) << "\n";
+    }
+
+    if (update) {
+        write_tolerances(tolerance_file, tolerances);
+        return 0;
+    }
+
+    std::cout << (ok ? "All scenes match their references.\n" : "Image regression detected.\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ============================================================
+// RayTracerClient: sends jobs to a render daemon
+//
+// Test client for `RayTracer --socket path` (see
+// src/render_daemon.h). Sends the job file (or stdin) to the
+// daemon's socket, then prints the daemon's replies, one line
+// per job, as they arrive.
+//
+// Usage: RayTracerClient socket_path [job_file]
+//
+// A camera sweep of three frames:
+//
+//   for i in 1 2 3; do
+//     echo "lookfrom $i 2 3"; echo "output sweep_$i.ppm"; echo render
+//   done | RayTracerClient /tmp/raytracer.sock
+//
+// The exit code is 1 if any job failed, 2 if the daemon could
+// not be reached.
+// ============================================================
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " socket_path [job_file]\n";
+        return 2;
+    }
+    std::string path = argv[1];
+
+    std::ostringstream jobs;
+    if (argc == 3) {
+        std::ifstream file(argv[2]);
+        if (!file) {
+            std::cerr << "Cannot read " << argv[2] << "\n";
+            return 2;
+        }
+        jobs << file.rdbuf();
+    } else {
+        jobs << std::cin.rdbuf();
+    }
+    std::string request = jobs.str();
+    if (!request.empty() && request.back() != '\n') request += '\n';
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << path << "\n";
+        return 2;
+    }
+    path.copy(address.sun_path, path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Cannot connect to " << path << ": " << std::strerror(errno) << "\n";
+        if (fd >= 0) close(fd);
+        return 2;
+    }
+
+    // All jobs at once; closing our side tells the daemon there are no more
+    for (size_t sent = 0; sent < request.size();) {
+        ssize_t n = send(fd, request.data() + sent, request.size() - sent, 0);
+        if (n <= 0) {
+            std::cerr << "Lost the connection to " << path << "\n";
+            close(fd);
+            return 2;
+        }
+        sent += size_t(n);
+    }
+    shutdown(fd, SHUT_WR);
+
+    // Replies, echoed line by line
+    bool failed = false;
+    std::string pending;
+    char buffer[4096];
+    ssize_t received;
+    while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        pending.append(buffer, size_t(received));
+        size_t end;
+        while ((end = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, end);
+            pending.erase(0, end + 1);
+            std::cout << line << std::endl;
+            if (line.rfind("error", 0) == 0) failed = true;
+        }
+    }
+    close(fd);
+
+    return failed ? 1 : 0;
+}
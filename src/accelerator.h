@@ -0,0 +1,111 @@
+#ifndef ACCELERATOR_H
+#define ACCELERATOR_H
+
+#include "bvh.h"
+#include "grid.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+// ============================================================
+// Choosing an acceleration structure
+//
+// An accelerator is a hittable built over a scene's primitives
+// that answers closest-hit queries faster than testing them
+// all. Two are available:
+//
+//  - bvh:  bvh_node (bvh.h); adapts to any distribution of
+//          primitives, but sorts them to build
+//  - grid: uniform_grid (grid.h); linear-time build and a
+//          cheap cell walk, but only for primitives of similar
+//          size
+//
+// make_accelerator() builds the requested one. With automatic
+// it looks at the spread of primitive sizes first (see
+// choose_accelerator()).
+// ============================================================
+enum class accelerator_type { bvh, grid, automatic };
+
+inline const char* accelerator_name(accelerator_type type) {
+    switch (type) {
+        case accelerator_type::bvh:  return "bvh";
+        case accelerator_type::grid: return "grid";
+        default:                     return "auto";
+    }
+}
+
+// Parses "bvh", "grid" or "auto"; false for anything else
+inline bool parse_accelerator(const std::string& name, accelerator_type& type) {
+    if (name == "bvh") type = accelerator_type::bvh;
+    else if (name == "grid") type = accelerator_type::grid;
+    else if (name == "auto") type = accelerator_type::automatic;
+    else return false;
+    return true;
+}
+
+// ------------------------------------------------------
+// Sizes of a scene's primitives: the longest side of each
+// bounding box, at the 10th, 50th and 90th percentile, and
+// how many are 'large' (uniform_grid sets those aside)
+// ------------------------------------------------------
+struct primitive_size_stats {
+    size_t count = 0;
+    real p10 = 0, median = 0, p90 = 0;
+    size_t large = 0;
+
+    explicit primitive_size_stats(const hittable_list& list,
+                                  double large_factor = grid_settings().large_factor) {
+        std::vector<real> sizes;
+        sizes.reserve(list.objects.size());
+        for (const auto& object : list.objects) {
+            aabb box = object->bounding_box();
+            sizes.push_back(std::max({ box.x.size(), box.y.size(), box.z.size() }));
+        }
+        count = sizes.size();
+        if (count == 0) return;
+
+        std::sort(sizes.begin(), sizes.end());
+        p10 = sizes[count / 10];
+        median = sizes[count / 2];
+        p90 = sizes[count * 9 / 10];
+        for (real size : sizes) large += size > real(large_factor) * median;
+    }
+
+    // Ratio of large to small primitives, ignoring the extremes
+    real spread() const { return p10 > 0 ? p90 / p10 : std::numeric_limits<real>::infinity(); }
+};
+
+// ------------------------------------------------------
+// choose_accelerator(list)
+// The grid for enough primitives of similar size (at most 4x
+// apart between the 10th and 90th percentile) with only a few
+// large ones; the BVH otherwise.
+// ------------------------------------------------------
+inline accelerator_type choose_accelerator(const hittable_list& list) {
+    const size_t min_grid_primitives = 64;
+    const real max_spread = 4;
+
+    primitive_size_stats stats(list);
+    if (stats.count < min_grid_primitives) return accelerator_type::bvh;
+    if (stats.spread() > max_spread) return accelerator_type::bvh;
+    if (stats.large > std::max<size_t>(2, stats.count / 100)) return accelerator_type::bvh;
+    return accelerator_type::grid;
+}
+
+// ------------------------------------------------------
+// make_accelerator(list, type)
+// Builds the accelerator of 'type' over 'list' (choosing one
+// first for automatic)
+// ------------------------------------------------------
+inline shared_ptr<hittable> make_accelerator(const hittable_list& list,
+                                             accelerator_type type = accelerator_type::automatic) {
+    if (type == accelerator_type::automatic) type = choose_accelerator(list);
+    if (type == accelerator_type::grid) return make_scene_object<uniform_grid>(list);
+    return make_scene_object<bvh_node>(list);
+}
+
+#endif // ACCELERATOR_H
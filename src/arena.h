@@ -0,0 +1,159 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// ============================================================
+// scene_arena: monotonic allocator for scene objects
+//
+// make_shared gives every primitive, material and BVH node a
+// heap block of its own (object plus reference counts). For a
+// large mesh that means millions of small allocations spread
+// over the heap at load time, and as many frees when the scene
+// is torn down. A scene_arena hands out memory from large
+// blocks instead:
+//
+//  - make<T>(args...) returns a shared_ptr<T> whose object and
+//    reference counts directly follow the previously made one
+//  - releasing such a pointer runs the destructor but frees
+//    nothing; the blocks are freed in one go once the arena and
+//    every object made from it are gone
+//
+// Objects keep shared_ptr ownership, so they mix freely with
+// heap-allocated ones, and they may outlive the arena object
+// itself (each one keeps the blocks alive).
+//
+// An arena is filled from one thread at a time. While an
+// arena_scope is active on a thread, make_scene_object() (used
+// by the scene loaders and BVH builders instead of make_shared)
+// allocates from its arena. Materials stay on the heap: they
+// are few, and as they are shared by many primitives, one of
+// them would keep a whole load arena alive after the scene has
+// been relocated (bvh_node::relocate()).
+// ============================================================
+class scene_arena {
+  public:
+    static constexpr size_t default_block_size = size_t(1) << 20;
+
+    explicit scene_arena(size_t block_size = default_block_size)
+        : state(new shared_state(block_size)) {}
+
+    scene_arena(const scene_arena&) = delete;
+    scene_arena& operator=(const scene_arena&) = delete;
+
+    ~scene_arena() { state->release(); }
+
+    // Constructs a T in the arena
+    template <typename T, typename... Args>
+    std::shared_ptr<T> make(Args&&... args) {
+        return std::allocate_shared<T>(allocator<T>(state), std::forward<Args>(args)...);
+    }
+
+    // Bytes handed out so far and blocks reserved for them
+    size_t bytes_used() const { return state->used; }
+    size_t block_count() const { return state->blocks.size(); }
+
+    // Arena of the innermost arena_scope on this thread, or nullptr
+    static scene_arena*& current() {
+        thread_local scene_arena* arena = nullptr;
+        return arena;
+    }
+
+  private:
+    // --------------------------------------------------------
+    // The blocks, shared by the arena object and every live
+    // allocation; whichever is released last frees them
+    // --------------------------------------------------------
+    struct shared_state {
+        size_t block_size;
+        std::vector<std::unique_ptr<std::byte[]>> blocks;
+        std::byte* next = nullptr;  // Free space in the newest block
+        size_t remaining = 0;
+        size_t used = 0;
+        std::atomic<size_t> references{1};  // The arena + live allocations
+
+        explicit shared_state(size_t block_size) : block_size(block_size) {}
+
+        void* allocate(size_t size, size_t alignment) {
+            size_t padding = (alignment - reinterpret_cast<uintptr_t>(next) % alignment) % alignment;
+            if (padding + size > remaining) {
+                // Oversized requests get a block of their own
+                size_t bytes = std::max(block_size, size + alignment);
+                blocks.emplace_back(new std::byte[bytes]);
+                next = blocks.back().get();
+                remaining = bytes;
+                padding = (alignment - reinterpret_cast<uintptr_t>(next) % alignment) % alignment;
+            }
+            void* p = next + padding;
+            next += padding + size;
+            remaining -= padding + size;
+            used += size;
+            references.fetch_add(1, std::memory_order_relaxed);
+            return p;
+        }
+
+        void release() {
+            if (references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete this;
+        }
+    };
+
+    // Standard allocator over shared_state, as std::allocate_shared needs it
+    template <typename T>
+    struct allocator {
+        using value_type = T;
+
+        shared_state* state;
+
+        explicit allocator(shared_state* state) : state(state) {}
+        template <typename U>
+        allocator(const allocator<U>& other) : state(other.state) {}
+
+        T* allocate(size_t n) { return static_cast<T*>(state->allocate(n * sizeof(T), alignof(T))); }
+        void deallocate(T*, size_t) { state->release(); }
+
+        template <typename U>
+        bool operator==(const allocator<U>& other) const { return state == other.state; }
+        template <typename U>
+        bool operator!=(const allocator<U>& other) const { return state != other.state; }
+    };
+
+    shared_state* state;
+};
+
+// ------------------------------------------------------
+// arena_scope: routes make_scene_object() on this thread
+// to 'arena' until the scope ends. Scopes nest.
+// ------------------------------------------------------
+class arena_scope {
+  public:
+    explicit arena_scope(scene_arena& arena) : previous(scene_arena::current()) {
+        scene_arena::current() = &arena;
+    }
+    ~arena_scope() { scene_arena::current() = previous; }
+
+    arena_scope(const arena_scope&) = delete;
+    arena_scope& operator=(const arena_scope&) = delete;
+
+  private:
+    scene_arena* previous;
+};
+
+// ------------------------------------------------------
+// make_shared for scene objects: allocates from the active
+// arena_scope's arena if there is one, else from the heap
+// ------------------------------------------------------
+template <typename T, typename... Args>
+inline std::shared_ptr<T> make_scene_object(Args&&... args) {
+    if (scene_arena* arena = scene_arena::current())
+        return arena->make<T>(std::forward<Args>(args)...);
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+#endif // ARENA_H
@@ -4,8 +4,38 @@
 #include "aabb.h"
 #include "hittable.h"
 #include "hittable_list.h"
+#include "morton.h"
 
 #include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// ------------------------------------------------------------
+// BVH construction strategies
+//  - median:         sort along the longest axis and split in half
+//  - lbvh:           linear BVH from Morton-sorted centroids,
+//                    near-instant to build
+//  - lbvh_optimized: lbvh followed by SAH-driven tree rotations
+// ------------------------------------------------------------
+enum class bvh_split_method { median, lbvh, lbvh_optimized };
+
+inline const char* split_method_name(bvh_split_method method) {
+    switch (method) {
+        case bvh_split_method::lbvh:           return "lbvh";
+        case bvh_split_method::lbvh_optimized: return "lbvh_optimized";
+        default:                               return "median";
+    }
+}
+
+// Parses "median", "lbvh" or "lbvh_optimized"; false for anything else
+inline bool parse_split_method(const std::string& name, bvh_split_method& method) {
+    if (name == "median") method = bvh_split_method::median;
+    else if (name == "lbvh") method = bvh_split_method::lbvh;
+    else if (name == "lbvh_optimized") method = bvh_split_method::lbvh_optimized;
+    else return false;
+    return true;
+}
 
 // ============================================================
 // bvh_node: Bounding Volume Hierarchy node
@@ -27,6 +57,43 @@ class bvh_node : public hittable {
     bvh_node(hittable_list list)
         : bvh_node(list.objects, 0, list.objects.size()) {}
 
+    // --------------------------------------------------------
+    // Constructor: build BVH from a hittable_list with the
+    // chosen construction strategy.
+    // --------------------------------------------------------
+    bvh_node(hittable_list list, bvh_split_method method) {
+        if (method == bvh_split_method::median || list.objects.size() < 3) {
+            *this = bvh_node(list.objects, 0, list.objects.size());
+            return;
+        }
+
+        *this = build_lbvh(list.objects);
+        if (method == bvh_split_method::lbvh_optimized)
+            optimize_rotations();
+    }
+
+    // --------------------------------------------------------
+    // Constructor: inner node over two already-built children.
+    // Used by the bottom-up builders.
+    // --------------------------------------------------------
+    bvh_node(shared_ptr<hittable> left, shared_ptr<hittable> right)
+        : left(left), right(right)
+    {
+        bbox = aabb(left->bounding_box(), right->bounding_box());
+        build_cost = local_cost(child_build_cost(left), child_build_cost(right));
+    }
+
+    // --------------------------------------------------------
+    // Constructor: inner node with explicit bounds. Spatial-split
+    // builders pass bounds tighter than the children's own boxes,
+    // since each child only needs to cover its clipped part.
+    // --------------------------------------------------------
+    bvh_node(shared_ptr<hittable> left, shared_ptr<hittable> right, const aabb& bounds)
+        : left(left), right(right), bbox(bounds)
+    {
+        build_cost = local_cost(child_build_cost(left), child_build_cost(right));
+    }
+
     // --------------------------------------------------------
     // BVH builder from a subrange [start, end) of hittable objects.
     // Recursively splits objects along the longest axis of their
@@ -65,9 +132,13 @@ class bvh_node : public hittable {
 
             // Split objects into two halves
             auto mid = start + object_span / 2;
-            left  = make_shared<bvh_node>(objects, start, mid);
-            right = make_shared<bvh_node>(objects, mid, end);
+            left  = make_scene_object<bvh_node>(objects, start, mid);
+            right = make_scene_object<bvh_node>(objects, mid, end);
         }
+
+        // Remember the quality of the fresh tree so refit() can
+        // tell when moving primitives have degraded it
+        build_cost = local_cost(child_build_cost(left), child_build_cost(right));
     }
 
     // --------------------------------------------------------
@@ -80,8 +151,10 @@ class bvh_node : public hittable {
     // max t-value to the closest hit found so far.
     // --------------------------------------------------------
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        RT_COUNT(boxes_tested);
         if (!bbox.hit(r, ray_t))
             return false;
+        RT_COUNT(nodes_visited);
 
         bool hit_left = left->hit(r, ray_t, rec);
         bool hit_right = right->hit(r,
@@ -91,15 +164,425 @@ class bvh_node : public hittable {
         return hit_left || hit_right;
     }
 
+    // --------------------------------------------------------
+    // Packet traversal (see packet.h)
+    //
+    // At each node:
+    //  1. if the first and last active rays (opposite corners
+    //     of the pixel block) hit the box, the whole packet
+    //     descends (the common case for coherent rays)
+    //  2. otherwise an interval-arithmetic test over the packet
+    //     may reject the box for all rays at once
+    //  3. otherwise the packet has started to diverge: it is
+    //     narrowed to the rays that actually hit the box
+    // Children are visited near-first along the packet direction.
+    // When only a few rays remain or the packet is not coherent,
+    // the rest of the subtree is traced ray by ray.
+    // --------------------------------------------------------
+    void hit_packet(ray_packet& packet, interval ray_t,
+                    const int* active, int count) const override {
+        if (!packet.coherent || count < min_packet_rays) {
+            hittable::hit_packet(packet, ray_t, active, count);
+            return;
+        }
+
+        auto box_hit = [&](int k) {
+            RT_COUNT(boxes_tested);
+            return bbox.hit(packet.rays[k], interval(ray_t.min, packet.t_max[k]));
+        };
+
+        int narrowed[ray_packet::max_size];
+        bool first_hit = box_hit(active[0]);
+        bool last_hit = first_hit && box_hit(active[count - 1]);
+        if (!last_hit) {
+            if (!first_hit && !packet.may_hit(bbox, ray_t, active, count))
+                return;
+
+            int remaining = 0;
+            if (first_hit) narrowed[remaining++] = active[0];
+            for (int n = 1; n < count - 1; n++)
+                if (box_hit(active[n])) narrowed[remaining++] = active[n];
+            // (if the first ray hit, the last one was tested and missed)
+            if (!first_hit && box_hit(active[count - 1]))
+                narrowed[remaining++] = active[count - 1];
+            if (remaining == 0)
+                return;
+            active = narrowed;
+            count = remaining;
+        }
+        RT_COUNT(nodes_visited);
+
+        if (left == right) {
+            left->hit_packet(packet, ray_t, active, count);
+            return;
+        }
+
+        // Near child first, so the far one is traced with shorter t ranges
+        const vector3& dir = packet.rays[active[0]].direction();
+        aabb left_box = left->bounding_box(), right_box = right->bounding_box();
+        double left_dist = 0, right_dist = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            left_dist  += dir[axis] * (left_box.axis_interval(axis).min + left_box.axis_interval(axis).max);
+            right_dist += dir[axis] * (right_box.axis_interval(axis).min + right_box.axis_interval(axis).max);
+        }
+        const hittable* near_child = left_dist <= right_dist ? left.get() : right.get();
+        const hittable* far_child  = left_dist <= right_dist ? right.get() : left.get();
+
+        near_child->hit_packet(packet, ray_t, active, count);
+        far_child->hit_packet(packet, ray_t, active, count);
+    }
+
     // --------------------------------------------------------
     // Returns the bounding box of this node
     // --------------------------------------------------------
     aabb bounding_box() const override { return bbox; }
 
+    // Children of this node (equal for single-object leaves)
+    const shared_ptr<hittable>& left_child() const { return left; }
+    const shared_ptr<hittable>& right_child() const { return right; }
+
+    // --------------------------------------------------------
+    // SAH cost of this subtree: the expected cost of tracing a
+    // ray that hits this node's box, measured in units of one
+    // primitive intersection.
+    // --------------------------------------------------------
+    double sah_cost() const {
+        return local_cost(subtree_cost(left), subtree_cost(right));
+    }
+
+    // --------------------------------------------------------
+    // Refit after primitives have moved (e.g. instances given a
+    // new transform). Recomputes node bounds bottom-up while
+    // keeping the tree topology, which is much cheaper than a
+    // full rebuild.
+    //
+    // Refitting slowly degrades the tree as primitives drift
+    // away from their original neighbours. Once the bounds are
+    // up to date, the tree is walked top-down: the highest
+    // subtrees whose SAH cost has grown past rebuild_threshold
+    // times their cost at build time are rebuilt from their own
+    // primitives, and their children are not looked at again.
+    // Every primitive is rebuilt at most once per refit.
+    //
+    // Returns the SAH cost of the refitted tree.
+    // --------------------------------------------------------
+    double refit(double rebuild_threshold = 1.5) {
+        refit_bounds();
+        return rebuild_degraded(rebuild_threshold);
+    }
+
+    // --------------------------------------------------------
+    // Appends every primitive (non-BVH leaf object) under this
+    // node to 'out', once each: a primitive referenced from
+    // several leaves (spatial splits) is not repeated.
+    // --------------------------------------------------------
+    void collect_primitives(std::vector<shared_ptr<hittable>>& out) const {
+        std::unordered_set<const hittable*> seen;
+        for (const auto& primitive : out) seen.insert(primitive.get());
+        collect_leaves(out, &seen);
+    }
+
+    // --------------------------------------------------------
+    // Improves an existing tree with local tree rotations
+    // (Kensler 2008), a lightweight form of treelet
+    // restructuring. Walking bottom-up, each node tries to swap
+    // one child with a grandchild on the other side whenever
+    // that lowers the SAH cost. Bounds of the node itself never
+    // change, so the pass is purely local.
+    // --------------------------------------------------------
+    void optimize_rotations() {
+        if (right == left) return;
+
+        for (const auto& child : {left, right})
+            if (auto node = dynamic_cast<bvh_node*>(child.get()))
+                node->optimize_rotations();
+
+        try_rotation(left, right);
+        try_rotation(right, left);
+        build_cost = local_cost(child_build_cost(left), child_build_cost(right));
+    }
+
+    // --------------------------------------------------------
+    // Copies this tree into 'arena' in depth-first order: each
+    // node is followed by its left subtree and then its right
+    // one, with primitives right after the node that holds
+    // them, so traversal walks mostly forward through memory.
+    // Primitives referenced from several leaves (spatial
+    // splits) are copied once. Objects that cannot be copied
+    // (see hittable::copy_into) stay shared with this tree.
+    // --------------------------------------------------------
+    shared_ptr<bvh_node> relocate(scene_arena& arena) const {
+        // Find the primitives under several leaves; only those
+        // need a lookup table of their copies
+        std::vector<shared_ptr<hittable>> primitives;
+        collect_leaves(primitives, nullptr);
+        std::vector<const hittable*> leaves;
+        leaves.reserve(primitives.size());
+        for (const auto& primitive : primitives) leaves.push_back(primitive.get());
+        std::sort(leaves.begin(), leaves.end());
+
+        std::unordered_map<const hittable*, shared_ptr<hittable>> shared_copies;
+        for (size_t i = 1; i < leaves.size(); i++)
+            if (leaves[i] == leaves[i - 1]) shared_copies[leaves[i]] = nullptr;
+
+        return relocate(arena, shared_copies);
+    }
+
+    shared_ptr<hittable> copy_into(scene_arena& arena) const override { return relocate(arena); }
+
   private:
     shared_ptr<hittable> left;   // Left child
     shared_ptr<hittable> right;  // Right child
     aabb bbox;                   // Bounding box for this node
+    double build_cost = 0;       // SAH cost when this subtree was built
+    double refit_cost = 0;       // SAH cost after the last refit_bounds()
+
+    // Relative costs used by the surface area heuristic
+    static constexpr double traversal_cost = 1.0;
+    static constexpr double intersect_cost = 1.0;
+
+    // Below this many active rays a packet is traced ray by ray
+    static constexpr int min_packet_rays = 4;
+
+    // --------------------------------------------------------
+    // SAH cost of a node given the costs of its children,
+    // weighting each child by the probability that a ray
+    // through this node also hits the child's box.
+    // --------------------------------------------------------
+    double local_cost(double left_cost, double right_cost) const {
+        if (right == left)
+            return traversal_cost + left_cost;
+
+        // Children may stick out of a spatial-split node's box;
+        // only the part inside it can be reached through this node
+        double area = bbox.surface_area();
+        return traversal_cost
+             + (left->bounding_box().intersect(bbox).surface_area()  * left_cost
+              + right->bounding_box().intersect(bbox).surface_area() * right_cost) / area;
+    }
+
+    // Current SAH cost of a child: recurse into nodes, primitives cost one test
+    static double subtree_cost(const shared_ptr<hittable>& child) {
+        if (auto node = dynamic_cast<const bvh_node*>(child.get()))
+            return node->sah_cost();
+        return intersect_cost;
+    }
+
+    // Cost of a child as recorded when it was built
+    static double child_build_cost(const shared_ptr<hittable>& child) {
+        if (auto node = dynamic_cast<const bvh_node*>(child.get()))
+            return node->build_cost;
+        return intersect_cost;
+    }
+
+    // --------------------------------------------------------
+    // Rotation candidate for optimize_rotations(): 'other' is
+    // one child, 'inner' is its sibling with children (a, b).
+    // Swapping 'other' with a (or b) replaces the cost terms
+    //   SA(other)*c(other) + SA(inner)*c(inner)
+    // with those of the rotated pair; the cheapest option wins.
+    // --------------------------------------------------------
+    static void try_rotation(shared_ptr<hittable>& other, shared_ptr<hittable>& inner_ptr) {
+        auto inner = dynamic_cast<bvh_node*>(inner_ptr.get());
+        if (!inner || inner->left == inner->right) return;
+
+        auto area = [](const shared_ptr<hittable>& h) { return h->bounding_box().surface_area(); };
+
+        double c_other = child_build_cost(other);
+        double c_a = child_build_cost(inner->left);
+        double c_b = child_build_cost(inner->right);
+
+        double current = area(other) * c_other + area(inner_ptr) * inner->build_cost;
+
+        // Cost of the pair (kept, inner node over (x, y))
+        auto rotated = [&](const shared_ptr<hittable>& kept, double c_kept,
+                           const shared_ptr<hittable>& x, double c_x,
+                           const shared_ptr<hittable>& y, double c_y) {
+            double inner_area = aabb(x->bounding_box(), y->bounding_box()).surface_area();
+            double inner_cost = traversal_cost + (area(x) * c_x + area(y) * c_y) / inner_area;
+            return area(kept) * c_kept + inner_area * inner_cost;
+        };
+
+        double swap_a = rotated(inner->left,  c_a, other, c_other, inner->right, c_b);
+        double swap_b = rotated(inner->right, c_b, inner->left, c_a, other, c_other);
+
+        const double min_gain = 1e-9 * current;
+        if (swap_a < swap_b && swap_a < current - min_gain)
+            std::swap(other, inner->left);
+        else if (swap_b < current - min_gain)
+            std::swap(other, inner->right);
+        else
+            return;
+
+        inner->bbox = aabb(inner->left->bounding_box(), inner->right->bounding_box());
+        inner->build_cost = inner->local_cost(child_build_cost(inner->left),
+                                              child_build_cost(inner->right));
+    }
+
+    // --------------------------------------------------------
+    // Linear BVH (LBVH) construction
+    //
+    // 1. Compute a Morton code for each primitive's centroid,
+    //    normalized to the bounds of all centroids. 30-bit codes
+    //    are used for small scenes, 63-bit for large ones.
+    // 2. Radix-sort the codes in parallel (morton.h).
+    // 3. Emit the hierarchy top-down by splitting each sorted
+    //    range where its highest differing code bit flips.
+    // --------------------------------------------------------
+    static bvh_node build_lbvh(const std::vector<shared_ptr<hittable>>& objects) {
+        const size_t n = objects.size();
+
+        std::vector<vector3> centroids(n);
+        aabb centroid_bounds = aabb::empty;
+        for (size_t i = 0; i < n; i++) {
+            aabb box = objects[i]->bounding_box();
+            centroids[i] = 0.5 * vector3(box.x.min + box.x.max,
+                                         box.y.min + box.y.max,
+                                         box.z.min + box.z.max);
+            centroid_bounds = aabb(centroid_bounds, aabb(centroids[i], centroids[i]));
+        }
+
+        int bits_per_axis = (n > (size_t(1) << 18)) ? 21 : 10;
+        std::vector<morton_key> keys(n);
+        for (size_t i = 0; i < n; i++) {
+            auto normalized = [&](int axis) {
+                const interval& range = centroid_bounds.axis_interval(axis);
+                return (centroids[i][axis] - range.min) / range.size();
+            };
+            keys[i] = { morton_encode(normalized(0), normalized(1), normalized(2), bits_per_axis),
+                        uint32_t(i) };
+        }
+
+        radix_sort(keys, 3 * bits_per_axis);
+
+        auto root = emit_lbvh(objects, keys, 0, n, 3 * bits_per_axis - 1);
+        return *std::static_pointer_cast<bvh_node>(root);
+    }
+
+    // --------------------------------------------------------
+    // Emits the subtree for sorted keys [start, end). 'bit' is
+    // the highest code bit that may still differ in this range.
+    // Ranges whose codes are all equal are split in the middle.
+    // --------------------------------------------------------
+    static shared_ptr<hittable> emit_lbvh(const std::vector<shared_ptr<hittable>>& objects,
+                                          const std::vector<morton_key>& keys,
+                                          size_t start, size_t end, int bit) {
+        if (end - start == 1)
+            return objects[keys[start].index];
+
+        // Find the highest bit at which the first and last codes differ
+        uint64_t first = keys[start].code, last = keys[end - 1].code;
+        while (bit >= 0 && ((first >> bit) & 1) == ((last >> bit) & 1))
+            bit--;
+
+        size_t split;
+        if (bit < 0) {
+            split = start + (end - start) / 2;
+        } else {
+            // First key in the range with that bit set
+            auto it = std::partition_point(keys.begin() + start, keys.begin() + end,
+                [bit](const morton_key& k) { return ((k.code >> bit) & 1) == 0; });
+            split = size_t(it - keys.begin());
+        }
+
+        return make_scene_object<bvh_node>(emit_lbvh(objects, keys, start, split, bit - 1),
+                                           emit_lbvh(objects, keys, split, end, bit - 1));
+    }
+
+    // --------------------------------------------------------
+    // relocate() helpers. 'shared_copies' maps primitives that
+    // occur under several leaves to their copy once made.
+    // --------------------------------------------------------
+    shared_ptr<bvh_node> relocate(scene_arena& arena,
+                                  std::unordered_map<const hittable*, shared_ptr<hittable>>& shared_copies) const {
+        auto copy = arena.make<bvh_node>(*this);
+        copy->left = relocate_child(left, arena, shared_copies);
+        copy->right = (right == left) ? copy->left : relocate_child(right, arena, shared_copies);
+        return copy;
+    }
+
+    static shared_ptr<hittable> relocate_child(const shared_ptr<hittable>& child, scene_arena& arena,
+                                               std::unordered_map<const hittable*, shared_ptr<hittable>>& shared_copies) {
+        if (auto node = dynamic_cast<const bvh_node*>(child.get()))
+            return node->relocate(arena, shared_copies);
+
+        auto copy_of = [&] {
+            auto copy = child->copy_into(arena);
+            return copy ? copy : child;
+        };
+        auto found = shared_copies.find(child.get());
+        if (found == shared_copies.end())
+            return copy_of();
+        if (!found->second)
+            found->second = copy_of();
+        return found->second;
+    }
+
+    // --------------------------------------------------------
+    // refit() helpers. refit_bounds() recomputes the bounds and
+    // SAH cost of every node bottom-up; rebuild_degraded() then
+    // rebuilds the highest degraded subtrees and updates the
+    // costs above them. Both return the subtree's cost.
+    // --------------------------------------------------------
+    double refit_bounds() {
+        double left_cost  = refit_child(left);
+        double right_cost = (right == left) ? left_cost : refit_child(right);
+
+        bbox = aabb(left->bounding_box(), right->bounding_box());
+        refit_cost = local_cost(left_cost, right_cost);
+        return refit_cost;
+    }
+
+    double rebuild_degraded(double rebuild_threshold) {
+        // Leaf-level nodes (direct primitives) cannot improve
+        bool has_inner_child = dynamic_cast<bvh_node*>(left.get())
+                            || dynamic_cast<bvh_node*>(right.get());
+        if (!has_inner_child) return refit_cost;
+
+        if (refit_cost > rebuild_threshold * build_cost) {
+            std::vector<shared_ptr<hittable>> primitives;
+            collect_primitives(primitives);
+            *this = bvh_node(primitives, 0, primitives.size());
+            refit_cost = build_cost;
+            return refit_cost;
+        }
+
+        double left_cost  = rebuild_child(left, rebuild_threshold);
+        double right_cost = (right == left) ? left_cost : rebuild_child(right, rebuild_threshold);
+        refit_cost = local_cost(left_cost, right_cost);
+        return refit_cost;
+    }
+
+    // Refit a child if it is a node; primitives keep their own boxes
+    static double refit_child(const shared_ptr<hittable>& child) {
+        if (auto node = dynamic_cast<bvh_node*>(child.get()))
+            return node->refit_bounds();
+        return intersect_cost;
+    }
+
+    static double rebuild_child(const shared_ptr<hittable>& child, double rebuild_threshold) {
+        if (auto node = dynamic_cast<bvh_node*>(child.get()))
+            return node->rebuild_degraded(rebuild_threshold);
+        return intersect_cost;
+    }
+
+    // --------------------------------------------------------
+    // Appends the object of every leaf under this node to 'out'.
+    // With 'seen', objects already in it are skipped (and added
+    // to it); without, primitives referenced from several leaves
+    // appear once per leaf.
+    // --------------------------------------------------------
+    void collect_leaves(std::vector<shared_ptr<hittable>>& out,
+                        std::unordered_set<const hittable*>* seen) const {
+        for (const auto& child : {left, right}) {
+            if (auto node = dynamic_cast<const bvh_node*>(child.get()))
+                node->collect_leaves(out, seen);
+            else if (!seen || seen->insert(child.get()).second)
+                out.push_back(child);
+
+            if (right == left) break; // Single-object leaf
+        }
+    }
 
     // --------------------------------------------------------
     // Sorting helpers for BVH construction
@@ -0,0 +1,130 @@
+#ifndef BVH_STATS_H
+#define BVH_STATS_H
+
+#include "bvh.h"
+#include "counters.h"
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// ============================================================
+// bvh_statistics: quality report for a BVH
+//
+// Walks a bvh_node tree and gathers the numbers that explain
+// why a scene traces slowly: tree size and depth, how many
+// primitives sit in each leaf, the SAH cost, and how much the
+// boxes of sibling nodes overlap (rays in the overlap have to
+// visit both children).
+//
+// A "leaf" is the set of primitive children of one node.
+// ============================================================
+class bvh_statistics {
+  public:
+    size_t inner_nodes = 0;                   // Number of bvh_node objects
+    size_t leaves = 0;                        // Nodes with at least one primitive child
+    size_t primitive_references = 0;          // Primitive children over all leaves
+    size_t max_depth = 0;                     // Deepest leaf (root = depth 0)
+    std::vector<size_t> depth_histogram;      // Leaves per depth
+    std::map<size_t, size_t> leaf_size_histogram; // Leaves per primitive count
+    double sah_cost = 0;                      // SAH cost of the whole tree
+    double sibling_overlap = 0;               // Summed surface area of sibling box overlaps
+    double root_area = 0;                     // Surface area of the root box
+
+    // --------------------------------------------------------
+    // Gather statistics for the tree rooted at 'root'.
+    // --------------------------------------------------------
+    explicit bvh_statistics(const bvh_node& root) {
+        sah_cost = root.sah_cost();
+        root_area = root.bounding_box().surface_area();
+        visit(root, 0);
+    }
+
+    // --------------------------------------------------------
+    // Writes the report as JSON. If the renderer was built
+    // with RAYTRACER_DIAGNOSTICS, the per-ray traversal
+    // averages collected during rendering are included.
+    // --------------------------------------------------------
+    void write_json(std::ostream& out) const {
+        out << "{\n  \"bvh\": {\n"
+            << "    \"inner_nodes\": " << inner_nodes << ",\n"
+            << "    \"leaves\": " << leaves << ",\n"
+            << "    \"primitive_references\": " << primitive_references << ",\n"
+            << "    \"max_depth\": " << max_depth << ",\n"
+            << "    \"leaf_depth_histogram\": [";
+        for (size_t d = 0; d < depth_histogram.size(); d++)
+            out << (d ? ", " : "") << depth_histogram[d];
+        out << "],\n    \"leaf_size_histogram\": {";
+        bool first = true;
+        for (const auto& [size, count] : leaf_size_histogram) {
+            out << (first ? "" : ", ") << "\"" << size << "\": " << count;
+            first = false;
+        }
+        out << "},\n"
+            << "    \"sah_cost\": " << sah_cost << ",\n"
+            << "    \"sibling_overlap_area\": " << sibling_overlap << ",\n"
+            << "    \"sibling_overlap_ratio\": " << (root_area > 0 ? sibling_overlap / root_area : 0) << "\n"
+            << "  },\n  \"traversal\": ";
+
+#ifdef RAYTRACER_DIAGNOSTICS
+        const auto& totals = global_traversal_totals();
+        double rays = double(std::max<uint64_t>(totals.rays, 1));
+        out << "{\n"
+            << "    \"rays\": " << totals.rays << ",\n"
+            << "    \"nodes_visited_per_ray\": " << totals.nodes_visited / rays << ",\n"
+            << "    \"boxes_tested_per_ray\": " << totals.boxes_tested / rays << ",\n"
+            << "    \"primitives_tested_per_ray\": " << totals.primitives_tested / rays << "\n"
+            << "  }\n}\n";
+#else
+        out << "null\n}\n";
+#endif
+    }
+
+    // Write the JSON report to a file (next to render.log by default)
+    void write_json(const std::string& filename = "render_stats.json") const {
+        std::ofstream file(filename);
+        if (!file) {
+            std::cerr << "Failed to write BVH statistics: " << filename << "\n";
+            return;
+        }
+        write_json(file);
+    }
+
+  private:
+    void visit(const bvh_node& node, size_t depth) {
+        inner_nodes++;
+
+        const auto& left = node.left_child();
+        const auto& right = node.right_child();
+
+        if (left != right) {
+            aabb overlap = left->bounding_box().intersect(right->bounding_box())
+                                               .intersect(node.bounding_box());
+            if (!overlap.is_empty())
+                sibling_overlap += overlap.surface_area();
+        }
+
+        size_t primitives = 0;
+        for (const auto& child : {left, right}) {
+            if (auto child_node = dynamic_cast<const bvh_node*>(child.get()))
+                visit(*child_node, depth + 1);
+            else
+                primitives++;
+
+            if (left == right) break;
+        }
+
+        if (primitives > 0) {
+            leaves++;
+            primitive_references += primitives;
+            leaf_size_histogram[primitives]++;
+            max_depth = std::max(max_depth, depth);
+            if (depth_histogram.size() <= depth)
+                depth_histogram.resize(depth + 1);
+            depth_histogram[depth]++;
+        }
+    }
+};
+
+#endif // BVH_STATS_H
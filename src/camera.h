@@ -1,15 +1,32 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <algorithm>
+#include <chrono>
+#include <string>
 #include <thread>
 
+#include "heatmap.h"
 #include "hittable.h"
 #include "material.h"
+#include "thread_pool.h"
+#include "wavefront.h"
+
+// What the render-cost heatmap measures per pixel
+enum class cost_metric {
+    time,       // Wall-clock time spent on the pixel (microseconds)
+    traversal   // BVH nodes visited + primitives tested (needs RAYTRACER_DIAGNOSTICS)
+};
 
 // ------------------------------------------------------
 // Class: camera
 // A ray tracing camera with configurable parameters,
 // supporting sequential and multi-threaded rendering.
+//
+// The render functions are templates over the scene type.
+// For a final scene class (static_scene) every hit() call
+// in the render loop is resolved at compile time and can
+// inline; any other hittable goes through its vtable.
 // ------------------------------------------------------
 class camera {
 public:
@@ -25,47 +42,79 @@ public:
     vector3 lookfrom = vector3(0,0,0);  // Camera position
     vector3 lookat   = vector3(0,0,-1); // Target point the camera looks at
     vector3 vup      = vector3(0,1,0);  // "Up" direction for camera orientation
+    uint64_t seed    = 0;               // Random seed; same seed = same image
+
+    // Primary-ray packets: trace the first hit of packet_size x packet_size
+    // pixel blocks together (4 or 8; 0 = one ray at a time). Used by the
+    // parallel renderer; the image is identical either way.
+    int packet_size = 0;
+
+    // Wavefront integrator: the parallel renderer keeps many paths in
+    // flight and advances them one bounce at a time in batched stages
+    // (see wavefront.h) instead of recursing per pixel. Same image up
+    // to floating-point rounding; no cost map in this mode.
+    bool wavefront = false;
+
+    // Wavefront mode only: before each bounce after the first, sort the
+    // rays by origin cell and direction octant so that consecutive rays
+    // traverse the same parts of the scene (better cache use)
+    bool reorder_rays = false;
+
+    // Render-cost heatmap: when set, <cost_map>.ppm (false color) and
+    // <cost_map>.pfm (raw floats) are written after rendering
+    std::string cost_map;
+    cost_metric cost_type = cost_metric::time;
 
     // ------------------------------------------------------
-    // render(scene)
+    // render(scene, out)
     // Sequential render. Loops through all pixels, computes
-    // multiple samples for anti-aliasing, and outputs PPM.
+    // multiple samples for anti-aliasing, and outputs PPM
+    // (to stdout unless another stream is given).
     // ------------------------------------------------------
-    void render(const hittable& scene) {
+    template <typename Scene>
+    void render(const Scene& scene, std::ostream& out = std::cout) {
         initialize(); // Compute camera parameters
 
-        std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+        out << "P3\n" << image_width << ' ' << image_height << "\n255\n";
 
         for (int j = 0; j < image_height; j++) {
             std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
             for (int i = 0; i < image_width; i++) {
-                color pixel_color(0,0,0);
-                for (int sample = 0; sample < samples_per_pixel; sample++) {
-                    ray r = get_ray(i, j);
-                    pixel_color += ray_color(r, max_depth, scene);
-                }
-                write_color(std::cout, pixel_color * pixel_samples_scale);
+                color pixel_color = sample_pixel(i, j, scene);
+                write_color(out, pixel_color * pixel_samples_scale);
             }
         }
+        flush_traversal_counters();
+        write_cost_map_if_enabled();
         std::clog << "\rDone!                       \n";
     }
 
     // ------------------------------------------------------
-    // render_parallel(scene)
+    // render_parallel(scene, out)
     // Multi-threaded version of render(). Splits the image
     // into horizontal bands and assigns each to a thread.
     // ------------------------------------------------------
-    void render_parallel(const hittable& scene) {
+    template <typename Scene>
+    void render_parallel(const Scene& scene, std::ostream& out = std::cout) {
+        write_image(render_framebuffer(scene), out);
+    }
+
+    // ------------------------------------------------------
+    // render_framebuffer(scene)
+    // The rendering half of render_parallel(): traces the
+    // image on all hardware threads and returns the summed
+    // samples of every pixel (row-major, top row first).
+    // ------------------------------------------------------
+    template <typename Scene>
+    std::vector<color> render_framebuffer(const Scene& scene) {
         initialize();
 
         std::vector<std::thread> threads;
-        int thread_count = std::thread::hardware_concurrency();
+        int thread_count = std::max(1u, std::thread::hardware_concurrency());
         int rows_per_thread = image_height / thread_count;
 
-        // Framebuffer: 2D array to store colors from each thread
-        std::vector<std::vector<color>> framebuffer(
-            image_height, std::vector<color>(image_width)
-        );
+        // Framebuffer: colors from each thread, one row after another
+        std::vector<color> framebuffer(size_t(image_width) * image_height);
 
         // Launch threads, each processing its own row range
         for (int t = 0; t < thread_count; t++) {
@@ -73,21 +122,76 @@ public:
             int row_end = (t == thread_count - 1) ? image_height : row_start + rows_per_thread;
 
             threads.emplace_back(
-                &camera::render_rows, this, row_start, row_end,
+                &camera::render_rows<Scene>, this, row_start, row_end,
                 std::ref(scene), std::ref(framebuffer)
             );
         }
 
         // Wait for all threads to finish
         for (auto& thread : threads) thread.join();
+        write_cost_map_if_enabled();
 
-        // Output the image (done only once from main thread)
-        std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-        for (int j = 0; j < image_height; j++) {
-            for (int i = 0; i < image_width; i++) {
-                write_color(std::cout, framebuffer[j][i] * pixel_samples_scale);
-            }
-        }
+        return framebuffer;
+    }
+
+    // ------------------------------------------------------
+    // render_framebuffer(scene, pool)
+    // render_framebuffer() on the workers of 'pool' instead of
+    // threads of its own. The image is cut into bands of a few
+    // rows, one task each, so jobs rendered at the same time
+    // share the workers. Same image as the threaded version.
+    // ------------------------------------------------------
+    template <typename Scene>
+    std::vector<color> render_framebuffer(const Scene& scene, thread_pool& pool) {
+        std::vector<color> framebuffer(size_t(image_width) * prepare());
+        render_band(scene, 0, image_height, framebuffer, pool);
+        write_cost_map_if_enabled();
+
+        return framebuffer;
+    }
+
+    // ------------------------------------------------------
+    // prepare()
+    // Computes the derived camera parameters (every render
+    // function does this first) and returns the image height.
+    // Needed before render_band() and write_image() are used
+    // on their own.
+    // ------------------------------------------------------
+    int prepare() {
+        initialize();
+        return image_height;
+    }
+
+    // ------------------------------------------------------
+    // render_band(scene, row_start, row_end, framebuffer, pool)
+    // Traces rows [row_start, row_end) on the workers of 'pool'
+    // into a full-image framebuffer, after prepare(). Every
+    // pixel is seeded on its own, so a band comes out the same
+    // whichever process renders it (distributed.h).
+    // ------------------------------------------------------
+    template <typename Scene>
+    void render_band(const Scene& scene, int row_start, int row_end,
+                     std::vector<color>& framebuffer, thread_pool& pool) {
+        // Bands of pool_band_rows rows, or thinner ones when a
+        // small band would otherwise leave workers idle
+        int rows = row_end - row_start;
+        int task_rows = std::clamp(rows / int(pool.size()), 1, pool_band_rows);
+        int tasks = (rows + task_rows - 1) / task_rows;
+        pool.parallel_for(size_t(tasks), [&](size_t task) {
+            int start = row_start + int(task) * task_rows;
+            render_rows(start, std::min(start + task_rows, row_end), scene, framebuffer);
+        });
+    }
+
+    // ------------------------------------------------------
+    // write_image(framebuffer, out)
+    // Averages the summed samples and writes the image as PPM.
+    // Done only once from the main thread.
+    // ------------------------------------------------------
+    void write_image(const std::vector<color>& framebuffer, std::ostream& out) const {
+        out << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+        for (const color& pixel : framebuffer)
+            write_color(out, pixel * pixel_samples_scale);
     }
 
     // ------------------------------------------------------
@@ -95,19 +199,26 @@ public:
     // Helper for render_parallel(). Computes pixel colors
     // for the given row range and stores results in framebuffer.
     // ------------------------------------------------------
+    template <typename Scene>
     void render_rows(int start_row, int end_row,
-                     const hittable& scene,
-                     std::vector<std::vector<color>>& framebuffer) {
-        for (int j = start_row; j < end_row; j++) {
-            for (int i = 0; i < image_width; i++) {
-                color pixel_color(0, 0, 0);
-                for (int sample = 0; sample < samples_per_pixel; sample++) {
-                    ray r = get_ray(i, j);
-                    pixel_color += ray_color(r, max_depth, scene);
+                     const Scene& scene,
+                     std::vector<color>& framebuffer) {
+        if (wavefront && max_depth > 0) {
+            render_rows_wavefront(start_row, end_row, scene, framebuffer);
+        } else if (packet_size > 0 && max_depth > 0) {
+            int block = std::min(packet_size, 8);  // ray_packet holds 8x8 rays
+            for (int j = start_row; j < end_row; j += block)
+                for (int i = 0; i < image_width; i += block)
+                    sample_block(i, j, std::min(i + block, image_width),
+                                 std::min(j + block, end_row), scene, framebuffer);
+        } else {
+            for (int j = start_row; j < end_row; j++) {
+                for (int i = 0; i < image_width; i++) {
+                    framebuffer[size_t(j) * image_width + i] = sample_pixel(i, j, scene);
                 }
-                framebuffer[j][i] = pixel_color;
             }
         }
+        flush_traversal_counters();
     }
 
 private:
@@ -119,6 +230,10 @@ private:
     vector3 pixel_delta_u;      // Offset from one pixel to the next in x
     vector3 pixel_delta_v;      // Offset from one pixel to the next in y
     vector3 u, v, w;            // Camera coordinate system basis vectors
+    std::vector<float> cost_buffer; // Per-pixel render cost (empty if disabled)
+
+    static constexpr size_t wavefront_paths = size_t(1) << 16; // Paths in flight per thread
+    static constexpr int pool_band_rows = 8;  // Rows per thread_pool task (a whole 8x8 packet block)
 
     // ------------------------------------------------------
     // initialize()
@@ -157,6 +272,275 @@ private:
         vector3 viewport_upper_left =
             center - (focal_length * w) - viewport_u / 2 - viewport_v / 2;
         pixel00_loc = viewport_upper_left + 0.5 * (pixel_delta_u + pixel_delta_v);
+
+        // Per-pixel cost buffer for the heatmap
+        cost_buffer.clear();
+        if (!cost_map.empty())
+            cost_buffer.assign(size_t(image_width) * image_height, 0.0f);
+
+        if (!cost_map.empty() && wavefront) {
+            std::cerr << "Cost map is not available in wavefront mode\n";
+            cost_buffer.clear();
+        }
+
+#ifndef RAYTRACER_DIAGNOSTICS
+        if (!cost_map.empty() && cost_type == cost_metric::traversal) {
+            std::cerr << "Traversal cost map needs RAYTRACER_DIAGNOSTICS; using time instead\n";
+            cost_type = cost_metric::time;
+        }
+#endif
+    }
+
+    // ------------------------------------------------------
+    // sample_pixel(i, j, scene)
+    // Accumulates all samples of pixel (i,j) and, if the
+    // heatmap is enabled, records what the pixel cost.
+    // Returns the (unscaled) sum of the samples.
+    // ------------------------------------------------------
+    template <typename Scene>
+    color sample_pixel(int i, int j, const Scene& scene) {
+        auto start_time = std::chrono::steady_clock::now();
+        const auto& counters = local_traversal_counters();
+        uint64_t start_steps = counters.nodes_visited + counters.primitives_tested;
+
+        color pixel_color(0, 0, 0);
+        for (int sample = 0; sample < samples_per_pixel; sample++) {
+            seed_sample(i, j, sample);
+            ray r = get_ray(i, j);
+            pixel_color += ray_color(r, max_depth, scene);
+        }
+
+        if (!cost_buffer.empty()) {
+            float cost;
+            if (cost_type == cost_metric::traversal) {
+                cost = float(counters.nodes_visited + counters.primitives_tested - start_steps);
+            } else {
+                std::chrono::duration<float, std::micro> elapsed =
+                    std::chrono::steady_clock::now() - start_time;
+                cost = elapsed.count();
+            }
+            cost_buffer[size_t(j) * image_width + i] = cost;
+        }
+
+        return pixel_color;
+    }
+
+    // ------------------------------------------------------
+    // sample_block(i0, j0, i1, j1, scene, framebuffer)
+    // Packet version of sample_pixel() for the pixel block
+    // [i0,i1) x [j0,j1). For every sample index, the primary
+    // rays of the whole block are traced as one ray_packet;
+    // each ray is then shaded on its own from its first hit.
+    //
+    // Every pixel sample still draws exactly the random numbers
+    // it would draw in sample_pixel() (the generator state after
+    // get_ray() is saved and restored for shading), so the
+    // image is identical. The heatmap cost of the block is
+    // spread evenly over its pixels.
+    // ------------------------------------------------------
+    template <typename Scene>
+    void sample_block(int i0, int j0, int i1, int j1, const Scene& scene,
+                      std::vector<color>& framebuffer) {
+        auto start_time = std::chrono::steady_clock::now();
+        const auto& counters = local_traversal_counters();
+        uint64_t start_steps = counters.nodes_visited + counters.primitives_tested;
+
+        ray_packet packet;
+        uint64_t random_states[ray_packet::max_size];
+        int active[ray_packet::max_size];
+        color sums[ray_packet::max_size];
+        int width = i1 - i0;
+        int pixels = width * (j1 - j0);
+
+        for (int k = 0; k < pixels; k++) {
+            active[k] = k;
+            sums[k] = color(0, 0, 0);
+        }
+
+        for (int sample = 0; sample < samples_per_pixel; sample++) {
+            packet.clear();
+            for (int k = 0; k < pixels; k++) {
+                seed_sample(i0 + k % width, j0 + k / width, sample);
+                packet.add(get_ray(i0 + k % width, j0 + k / width));
+                random_states[k] = random_state();
+            }
+            packet.finalize();
+            scene.hit_packet(packet, interval(0.001, infinity), active, pixels);
+
+            for (int k = 0; k < pixels; k++) {
+                random_state() = random_states[k];
+                sums[k] += shade(packet.rays[k], packet.hit[k], packet.records[k], max_depth, scene);
+            }
+        }
+
+        for (int k = 0; k < pixels; k++)
+            framebuffer[size_t(j0 + k / width) * image_width + i0 + k % width] = sums[k];
+
+        if (!cost_buffer.empty()) {
+            float cost;
+            if (cost_type == cost_metric::traversal) {
+                cost = float(counters.nodes_visited + counters.primitives_tested - start_steps);
+            } else {
+                std::chrono::duration<float, std::micro> elapsed =
+                    std::chrono::steady_clock::now() - start_time;
+                cost = elapsed.count();
+            }
+            for (int k = 0; k < pixels; k++)
+                cost_buffer[size_t(j0 + k / width) * image_width + i0 + k % width] = cost / pixels;
+        }
+    }
+
+    // ------------------------------------------------------
+    // render_rows_wavefront(start_row, end_row, scene, framebuffer)
+    // Wavefront version of render_rows(). Pixels are processed
+    // in batches of up to wavefront_paths paths (all samples of
+    // a pixel go in the same batch). Each batch runs:
+    //  - generate:  one camera path per pixel sample
+    //  - intersect: closest hit of every live path
+    //  - shade:     emission, scattering and the next ray of
+    //               every live path; paths that miss, stop
+    //               scattering or run out of depth finish
+    //  - compact:   finished paths add their radiance to the
+    //               framebuffer and leave the queue
+    // until no path is left. With reorder_rays, secondary rays
+    // are sorted for coherence before each intersect stage.
+    // Each path carries its own generator state, so it draws
+    // the same random numbers as in the recursive ray_color().
+    // ------------------------------------------------------
+    template <typename Scene>
+    void render_rows_wavefront(int start_row, int end_row, const Scene& scene,
+                               std::vector<color>& framebuffer) {
+        size_t first = size_t(start_row) * image_width;
+        size_t last = size_t(end_row) * image_width;
+        size_t batch_pixels = std::max<size_t>(1, wavefront_paths / size_t(samples_per_pixel));
+
+        path_queue paths;
+        paths.reserve(std::min(batch_pixels, last - first) * samples_per_pixel);
+
+        for (size_t batch = first; batch < last; batch += batch_pixels) {
+            size_t batch_end = std::min(last, batch + batch_pixels);
+
+            // Generate
+            for (size_t p = batch; p < batch_end; p++) {
+                framebuffer[p] = color(0, 0, 0);
+                int i = int(p % image_width), j = int(p / image_width);
+                for (int sample = 0; sample < samples_per_pixel; sample++) {
+                    seed_sample(i, j, sample);
+                    ray r = get_ray(i, j);
+                    paths.push(r, uint32_t(p), max_depth, random_state());
+                }
+            }
+
+            for (int bounce = 0; !paths.empty(); bounce++) {
+                if (reorder_rays && bounce > 0)
+                    paths.sort_for_coherence();
+                intersect_paths(paths, scene);
+                shade_paths(paths);
+                paths.compact([&](size_t k) { framebuffer[paths.pixel[k]] += paths.radiance[k]; });
+            }
+        }
+    }
+
+    // Intersect stage: closest hit of every path's current
+    // ray, grouping the paths by the material they hit
+    template <typename Scene>
+    void intersect_paths(path_queue& paths, const Scene& scene) const {
+        auto& counters = local_traversal_counters();
+        paths.clear_groups();
+        for (size_t k = 0; k < paths.size(); k++) {
+            counters.rays++; // Always counted, see counters.h
+            paths.hit[k] = scene.hit(ray(paths.origin[k], paths.direction[k]),
+                                     interval(0.001, infinity), paths.records[k]);
+            paths.add_to_group(k);
+        }
+    }
+
+    // ------------------------------------------------------
+    // Shade stage: the loop body of ray_color() for every
+    // path. Light is accumulated front to back:
+    // radiance += throughput * emitted, throughput *= attenuation.
+    //
+    // The intersect stage has grouped the paths by material
+    // type, and each type is shaded in its own loop, reading the material's
+    // material_data instead of calling its virtual functions.
+    // Built-in reflective materials emit nothing and lights
+    // never scatter, so those loops skip the other half. Other
+    // material classes go through the virtual interface.
+    // ------------------------------------------------------
+    void shade_paths(path_queue& paths) const {
+        for (uint32_t k : paths.misses) {
+            paths.radiance[k] += paths.throughput[k] * background;
+            paths.done[k] = 1;
+        }
+
+        for (uint32_t k : paths.by_material[size_t(material_type::diffuse_light)]) {
+            paths.radiance[k] += paths.throughput[k] * paths.records[k].mat->data().albedo;
+            paths.done[k] = 1;
+        }
+
+        for (uint32_t k : paths.by_material[size_t(material_type::lambertian)]) {
+            const hit_record& rec = paths.records[k];
+            random_state() = paths.rng[k];
+            vector3 direction = lambertian_scatter_direction(rec.normal);
+            paths.rng[k] = random_state();
+            continue_path(paths, k, ray(rec.p, direction), rec.mat->data().albedo);
+        }
+
+        for (uint32_t k : paths.by_material[size_t(material_type::metal)]) {
+            const hit_record& rec = paths.records[k];
+            const material_data& data = rec.mat->data();
+            random_state() = paths.rng[k];
+            vector3 direction = metal_scatter_direction(paths.direction[k], rec.normal, data.fuzz);
+            paths.rng[k] = random_state();
+            if (dot(direction, rec.normal) > 0)
+                continue_path(paths, k, ray(rec.p, direction), data.albedo);
+            else
+                paths.done[k] = 1;
+        }
+
+        for (uint32_t k : paths.by_material[size_t(material_type::custom)]) {
+            random_state() = paths.rng[k];
+            const hit_record& rec = paths.records[k];
+            paths.radiance[k] += paths.throughput[k] * rec.mat->emitted();
+
+            ray scattered;
+            color attenuation;
+            if (rec.mat->scatter(ray(paths.origin[k], paths.direction[k]), rec, attenuation, scattered))
+                continue_path(paths, k, scattered, attenuation);
+            else
+                paths.done[k] = 1;
+            paths.rng[k] = random_state();
+        }
+    }
+
+    // Moves path k on to its scattered ray, or finishes it
+    // when it has no bounces left
+    static void continue_path(path_queue& paths, size_t k, const ray& scattered,
+                              const color& attenuation) {
+        if (--paths.depth[k] <= 0) {
+            paths.done[k] = 1;
+            return;
+        }
+        paths.throughput[k] = paths.throughput[k] * attenuation;
+        paths.origin[k] = scattered.origin();
+        paths.direction[k] = scattered.direction();
+    }
+
+    // ------------------------------------------------------
+    // seed_sample(i, j, sample)
+    // Reseeds this thread's generator for one pixel sample, so
+    // the image does not depend on thread count or the order
+    // in which pixels are rendered.
+    // ------------------------------------------------------
+    void seed_sample(int i, int j, int sample) const {
+        uint64_t pixel = uint64_t(j) * uint64_t(image_width) + uint64_t(i);
+        seed_random(mix_bits(seed ^ mix_bits(pixel)) + uint64_t(sample));
+    }
+
+    // Write the heatmap files once rendering has finished
+    void write_cost_map_if_enabled() const {
+        if (!cost_buffer.empty())
+            write_cost_map(cost_map, image_width, image_height, cost_buffer);
     }
 
     // ------------------------------------------------------
@@ -195,22 +579,36 @@ private:
     //  - ray hits nothing (returns background color)
     //  - material does not scatter
     // ------------------------------------------------------
-    color ray_color(const ray& r, int depth, const hittable& scene) const {
+    template <typename Scene>
+    color ray_color(const ray& r, int depth, const Scene& scene) const {
         if (depth <= 0)
             return color(0,0,0); // No more light contribution
 
         hit_record rec;
+        bool hit = scene.hit(r, interval(0.001, infinity), rec);
+        return shade(r, hit, rec, depth, scene);
+    }
+
+    // ------------------------------------------------------
+    // shade(ray, hit, rec, depth, scene)
+    // The part of ray_color() after the intersection: the
+    // color of ray 'r' given its closest hit 'rec' (if 'hit').
+    // Packet rendering calls it directly with packet results.
+    // ------------------------------------------------------
+    template <typename Scene>
+    color shade(const ray& r, bool hit, const hit_record& rec, int depth, const Scene& scene) const {
+        local_traversal_counters().rays++; // Always counted, see counters.h
 
         // Ray misses: return background
-        if (!scene.hit(r, interval(0.001, infinity), rec))
+        if (!hit)
             return background;
 
         ray scattered;
         color attenuation;
-        color color_from_emission = rec.mat->emitted();
+        color color_from_emission;
 
         // If material absorbs light, only emission contributes
-        if (!rec.mat->scatter(r, rec, attenuation, scattered))
+        if (!scatter_material(*rec.mat, r, rec, color_from_emission, attenuation, scattered))
             return color_from_emission;
 
         // Combine emission + reflected/refracted light
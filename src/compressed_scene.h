@@ -0,0 +1,267 @@
+#ifndef COMPRESSED_SCENE_H
+#define COMPRESSED_SCENE_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "static_scene.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================
+// compressed_scene<Quantized, Primitives...>: a flat BVH with
+// quantized node bounds
+//
+// A static_scene node stores its box as six reals: 48 bytes in
+// double precision, 56 with the child references. Large meshes
+// then spend more memory on the tree than on the triangles,
+// and incoherent rays spend their time waiting for nodes to
+// arrive from memory. Here each node stores the boxes of its
+// two children instead, as integers (Quantized: uint8_t or
+// uint16_t) on a grid over the node's own box:
+//
+//   min = box.min + q_min * step,  max = box.max - q_max * step
+//   step = box size / (2^bits - 1), per axis
+//
+// A node is 20 bytes with 8-bit bounds (three to a cache line)
+// and 32 bytes with 16-bit ones. The root box is kept in full.
+// Entering a node, traversal decodes both child boxes from the
+// node's own decoded box, tests them, and pushes the children
+// that were hit along with their boxes.
+//
+// Rounding is conservative: the build quantizes each child
+// against the same decoded parent box traversal will see, and
+// checks every decoded bound with the arithmetic traversal
+// uses, so decoded boxes always contain the exact ones. The
+// slightly larger boxes only let more rays through to the
+// primitives, which are visited in static_scene's order, so
+// hits are identical to the bvh_node's. Primitives are stored
+// as in static_scene.
+//
+// Decoding costs arithmetic on every node, so this only pays
+// off when traversal waits on memory: a tree much larger than
+// the caches and incoherent rays.
+// ============================================================
+template <typename Quantized, typename... Primitives>
+class compressed_scene final : public hittable {
+    static_assert(std::is_same_v<Quantized, uint8_t> || std::is_same_v<Quantized, uint16_t>,
+                  "bounds are quantized to 8 or 16 bits");
+
+  public:
+    // --------------------------------------------------------
+    // from_bvh(root)
+    // Flattens and compresses 'root', or returns nullptr under
+    // the same conditions as static_scene::from_bvh()
+    // --------------------------------------------------------
+    static shared_ptr<compressed_scene> from_bvh(const bvh_node& root) {
+        auto scene = shared_ptr<compressed_scene>(new compressed_scene());
+        int depth = 0;
+        std::unordered_map<const hittable*, uint32_t> primitive_index;
+        scene->bbox = root.bounding_box();
+        if (!scene->flatten(root, frame(scene->bbox), primitive_index, 1, depth) || depth >= stack_size)
+            return nullptr;
+        return scene;
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        RT_COUNT(boxes_tested);
+        if (!bbox.hit(r, ray_t))
+            return false;
+
+        // The inverse direction aabb::hit() computes for every box
+        const vector3& origin = r.origin();
+        const real inv_dir[3] = { 1 / r.direction()[0], 1 / r.direction()[1], 1 / r.direction()[2] };
+
+        struct entry {
+            uint32_t ref;
+            frame box;
+        };
+        entry stack[stack_size];
+        int top = 0;
+        stack[top++] = { 0, frame(bbox) };  // Root node
+        bool hit_anything = false;
+
+        while (top > 0) {
+            const entry& e = stack[--top];
+            interval range(ray_t.min, hit_anything ? rec.t : ray_t.max);
+
+            if (primitive_arrays::is_primitive(e.ref)) {
+                if (primitives.hit(e.ref, r, range, rec))
+                    hit_anything = true;
+                continue;
+            }
+            RT_COUNT(nodes_visited);
+
+            // Both children are decoded and tested here; the right
+            // one is pushed first so the left subtree is finished first
+            const node& n = nodes[e.ref];
+            frame children[2];
+            e.box.children(n, children);
+            for (int side = 1; side >= 0; side--) {
+                uint32_t child = n.child[side];
+                if (side == 1 && child == n.child[0]) continue;  // Single-object leaf
+                if (!primitive_arrays::is_primitive(child)) {
+                    RT_COUNT(boxes_tested);
+                    if (!children[side].hit(origin, inv_dir, range)) continue;
+                }
+                stack[top++] = { child, children[side] };
+            }
+        }
+        return hit_anything;
+    }
+
+    // Packets are traced ray by ray, each through the non-virtual hit() above
+    void hit_packet(ray_packet& packet, interval ray_t,
+                    const int* active, int count) const override {
+        for (int n = 0; n < count; n++) {
+            int k = active[n];
+            if (hit(packet.rays[k], interval(ray_t.min, packet.t_max[k]), packet.records[k])) {
+                packet.t_max[k] = packet.records[k].t;
+                packet.hit[k] = true;
+            }
+        }
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    size_t node_count() const { return nodes.size(); }
+    size_t node_bytes() const { return nodes.size() * sizeof(node); }
+    size_t primitive_count() const { return primitives.size(); }
+
+  private:
+    using primitive_arrays = static_primitives<Primitives...>;
+    static constexpr int stack_size = 64;
+    static constexpr Quantized levels = std::numeric_limits<Quantized>::max();
+
+    struct node {
+        Quantized lower[2][3];  // Child boxes: q_min per child and axis
+        Quantized upper[2][3];  // and q_max (counted down from the parent's max)
+        uint32_t child[2];      // Node index or primitive reference
+    };
+
+    std::vector<node> nodes;
+    primitive_arrays primitives;
+    aabb bbox;
+
+    compressed_scene() = default;
+
+    // Grid step along one axis of a decoded box, and its bounds
+    static real step(real min, real max) { return (max - min) * (real(1) / levels); }
+    static real decode_min(real min, real step, Quantized q) { return min + real(q) * step; }
+    static real decode_max(real max, real step, Quantized q) { return max - real(q) * step; }
+
+    // --------------------------------------------------------
+    // A decoded box. Plain arrays rather than an aabb, so the
+    // per-level array on the traversal stack needs no setup.
+    // --------------------------------------------------------
+    struct frame {
+        real min[3], max[3];
+
+        frame() = default;
+        explicit frame(const aabb& box) {
+            for (int axis = 0; axis < 3; axis++) {
+                min[axis] = box.axis_interval(axis).min;
+                max[axis] = box.axis_interval(axis).max;
+            }
+        }
+
+        // Boxes of both children of 'n', whose own box this is
+        void children(const node& n, frame* result) const {
+            for (int axis = 0; axis < 3; axis++) {
+                real s = step(min[axis], max[axis]);
+                for (int side = 0; side < 2; side++) {
+                    result[side].min[axis] = decode_min(min[axis], s, n.lower[side][axis]);
+                    result[side].max[axis] = decode_max(max[axis], s, n.upper[side][axis]);
+                }
+            }
+        }
+
+        // aabb::hit() with the inverse direction computed once per ray
+        bool hit(const vector3& origin, const real* inv_dir, interval ray_t) const {
+            for (int axis = 0; axis < 3; axis++) {
+                real t0 = (min[axis] - origin[axis]) * inv_dir[axis];
+                real t1 = (max[axis] - origin[axis]) * inv_dir[axis];
+                if (t0 < t1) {
+                    if (t0 > ray_t.min) ray_t.min = t0;
+                    if (t1 * aabb::exit_scale < ray_t.max) ray_t.max = t1 * aabb::exit_scale;
+                } else {
+                    if (t1 > ray_t.min) ray_t.min = t1;
+                    if (t0 * aabb::exit_scale < ray_t.max) ray_t.max = t0 * aabb::exit_scale;
+                }
+                if (ray_t.max <= ray_t.min)
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    // --------------------------------------------------------
+    // Quantizes 'child' within 'box': the finest grid cells
+    // whose decoded bounds still contain the child's. Parts of
+    // the child outside 'box' (spatial-split nodes) are clipped:
+    // traversal has already tested the parent.
+    // --------------------------------------------------------
+    static void encode(node& n, int side, const frame& box, const aabb& child) {
+        for (int axis = 0; axis < 3; axis++) {
+            const real min = box.min[axis], max = box.max[axis];
+            const interval& target = child.axis_interval(axis);
+            real s = step(min, max);
+
+            auto cells = [s](real distance) {
+                if (!(s > 0) || !(distance > 0)) return real(0);
+                return std::min(std::floor(distance / s), real(levels));
+            };
+            Quantized lo = Quantized(cells(target.min - min));
+            while (lo > 0 && decode_min(min, s, lo) > target.min) lo--;
+            Quantized hi = Quantized(cells(max - target.max));
+            while (hi > 0 && decode_max(max, s, hi) < target.max) hi--;
+
+            n.lower[side][axis] = lo;
+            n.upper[side][axis] = hi;
+        }
+    }
+
+    // --------------------------------------------------------
+    // Appends 'source' (decoded box 'box') and its subtree in
+    // depth-first order, as static_scene::flatten() does
+    // --------------------------------------------------------
+    bool flatten(const bvh_node& source, const frame& box,
+                 std::unordered_map<const hittable*, uint32_t>& primitive_index,
+                 int level, int& depth) {
+        depth = std::max(depth, level);
+        uint32_t index = uint32_t(nodes.size());
+        nodes.push_back({});
+
+        const shared_ptr<hittable>* children[2] = { &source.left_child(), &source.right_child() };
+        for (int side = 0; side < 2; side++) {
+            const hittable* child = children[side]->get();
+            uint32_t ref;
+            if (side == 1 && child == children[0]->get()) {
+                ref = nodes[index].child[0];  // Single-object leaf
+            } else if (auto inner = dynamic_cast<const bvh_node*>(child)) {
+                // The child is built against the box traversal will decode
+                encode(nodes[index], side, box, inner->bounding_box());
+                frame decoded[2];
+                box.children(nodes[index], decoded);
+                ref = uint32_t(nodes.size());
+                if (!flatten(*inner, decoded[side], primitive_index, level + 1, depth)) return false;
+            } else {
+                // Primitives are tested directly; their box is not used
+                if (!primitives.add(*child, primitive_index, ref)) return false;
+            }
+            nodes[index].child[side] = ref;
+        }
+        return true;
+    }
+};
+
+// Quantized counterparts of sphere_tri_scene
+using sphere_tri_scene_8 = compressed_scene<uint8_t, sphere, tri>;
+using sphere_tri_scene_16 = compressed_scene<uint16_t, sphere, tri>;
+
+#endif // COMPRESSED_SCENE_H
@@ -0,0 +1,74 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+
+// ============================================================
+// Traversal counters (diagnostics mode)
+//
+// When the project is configured with -DRAYTRACER_DIAGNOSTICS=ON,
+// RT_COUNT(field) increments a per-thread counter. Each render
+// thread adds its counters to the global totals once, when it
+// finishes (flush_traversal_counters), so the hot loops never
+// touch shared memory.
+//
+// In normal builds RT_COUNT compiles to nothing. The ray count
+// is the exception: it is always kept (one thread-local add per
+// ray) so the logger can report rays per second.
+// ============================================================
+struct traversal_counters {
+    uint64_t rays = 0;               // Rays traced against the scene
+    uint64_t nodes_visited = 0;      // BVH nodes whose box was hit and entered
+    uint64_t boxes_tested = 0;       // Ray-box tests
+    uint64_t primitives_tested = 0;  // Ray-primitive tests
+};
+
+// Counters of the calling thread
+inline traversal_counters& local_traversal_counters() {
+    thread_local traversal_counters counters;
+    return counters;
+}
+
+// Totals over all threads that have flushed
+struct traversal_totals {
+    std::atomic<uint64_t> rays{0};
+    std::atomic<uint64_t> nodes_visited{0};
+    std::atomic<uint64_t> boxes_tested{0};
+    std::atomic<uint64_t> primitives_tested{0};
+};
+
+inline traversal_totals& global_traversal_totals() {
+    static traversal_totals totals;
+    return totals;
+}
+
+// ------------------------------------------------------
+// Adds the calling thread's counters to the global
+// totals and resets them. Called by the camera at the
+// end of every render thread.
+// ------------------------------------------------------
+inline void flush_traversal_counters() {
+    auto& local = local_traversal_counters();
+    auto& totals = global_traversal_totals();
+    totals.rays += local.rays;
+#ifdef RAYTRACER_DIAGNOSTICS
+    totals.nodes_visited     += local.nodes_visited;
+    totals.boxes_tested      += local.boxes_tested;
+    totals.primitives_tested += local.primitives_tested;
+#endif
+    local = traversal_counters();
+}
+
+// Total rays traced by all finished render threads
+inline uint64_t total_rays_traced() {
+    return global_traversal_totals().rays;
+}
+
+#ifdef RAYTRACER_DIAGNOSTICS
+#define RT_COUNT(field) (++local_traversal_counters().field)
+#else
+#define RT_COUNT(field) ((void)0)
+#endif
+
+#endif // COUNTERS_H
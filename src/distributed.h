@@ -0,0 +1,352 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include "camera.h"
+#include "input.h"
+#include "log.h"
+#include "socket_stream.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================
+// Distributed tile rendering
+//
+// One image rendered by several processes, on one machine or
+// many. A tile_coordinator holds the camera and the image; it
+// listens on a TCP port, and tile_workers, each with the same
+// scene loaded and built, connect to it. The coordinator sends
+// each worker its camera, then hands out tiles (bands of rows)
+// one at a time. A worker renders a tile on its thread pool and
+// sends back the summed samples of every pixel as raw 'real'
+// values (float in a RAYTRACER_FLOAT build, double otherwise).
+// The coordinator copies them into its framebuffer and writes
+// the image as a single process would.
+//
+// Every pixel sample is seeded from the camera seed and its
+// position (camera::seed_sample), and every pixel is rendered
+// whole by one worker, so the image is bit-identical to a
+// single-process render with the same seed, however the tiles
+// were spread. (Splitting a pixel's samples between workers
+// would change the order of the additions, and with it the
+// rounding.)
+//
+// Workers may join at any time. A worker that disconnects, or
+// does not answer within tile_timeout, is dropped and its tile
+// goes back in the queue. Once the queue is empty, idle workers
+// take copies of tiles still being rendered elsewhere, so one
+// slow worker does not hold up the image; the first copy to
+// come back is used.
+//
+// Protocol (text lines, then raw pixels):
+//
+//   coordinator -> worker:  camera / <settings> / end
+//                           tile <index> <row_start> <row_end>
+//   worker -> coordinator:  pixels <index> <row_start> <row_end> <sizeof(real)>
+//                           followed by (row_end - row_start) * width * 3 reals
+//
+// The connection closing ends the worker. Coordinator and workers
+// must use the same build (precision and byte order).
+// ============================================================
+struct tile_settings {
+    int tile_rows = 16;           // Rows per tile
+    double tile_timeout = 60;     // Seconds a worker may take for one tile
+    int max_copies = 2;           // Workers rendering the same tile at once
+};
+
+#ifndef _WIN32
+
+// ------------------------------------------------------
+// tile_worker: renders the tiles a coordinator sends
+// ------------------------------------------------------
+class tile_worker {
+  public:
+    template <typename Scene>
+    tile_worker(shared_ptr<Scene> scene, Logger& logger, thread_pool& pool = shared_thread_pool())
+        : logger(logger),
+          render([scene, &pool](camera& cam, int row_start, int row_end, std::vector<color>& framebuffer) {
+              cam.render_band(*scene, row_start, row_end, framebuffer, pool);
+          }) {}
+
+    // --------------------------------------------------------
+    // serve(host, port, connect_seconds)
+    // Connects to the coordinator at host:port, retrying for up
+    // to 'connect_seconds', and renders tiles until it closes
+    // the connection. Returns false if it could not connect.
+    // --------------------------------------------------------
+    bool serve(const std::string& host, int port, double connect_seconds = 10) {
+        int fd = -1;
+        auto give_up = std::chrono::steady_clock::now()
+                     + std::chrono::milliseconds(int(connect_seconds * 1000));
+        while ((fd = tcp_connect(host, port)) < 0 && std::chrono::steady_clock::now() < give_up)
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (fd < 0) {
+            std::cerr << "Worker: cannot connect to " << host << ":" << port << "\n";
+            return false;
+        }
+        logger.log("Worker connected to " + host + ":" + std::to_string(port));
+
+        {
+            socket_buffer buffer(fd);
+            std::iostream stream(&buffer);
+            serve(stream);
+        }
+        ::close(fd);
+        return true;
+    }
+
+  private:
+    Logger& logger;
+    std::function<void(camera&, int, int, std::vector<color>&)> render;
+
+    void serve(std::iostream& stream) {
+        camera cam;
+        std::vector<color> framebuffer;
+        std::vector<real> values;
+        std::string line;
+        size_t tiles = 0;
+
+        auto timer = logger.phase("worker");
+        while (std::getline(stream, line)) {
+            std::istringstream iss(line);
+            std::string command;
+            iss >> command;
+
+            if (command == "camera") {
+                // Settings up to "end"; the heatmap is the coordinator's business
+                cam = camera();
+                std::string key;
+                while (stream >> key && key != "end") read_camera_setting(stream, key, cam);
+                std::getline(stream, line);
+                cam.cost_map.clear();
+                framebuffer.assign(size_t(cam.image_width) * cam.prepare(), color(0, 0, 0));
+            } else if (command == "tile") {
+                size_t index;
+                int row_start, row_end;
+                iss >> index >> row_start >> row_end;
+                render(cam, row_start, row_end, framebuffer);
+
+                auto first = framebuffer.begin() + size_t(row_start) * cam.image_width;
+                auto last = framebuffer.begin() + size_t(row_end) * cam.image_width;
+                values.clear();
+                for (auto pixel = first; pixel != last; ++pixel)
+                    values.insert(values.end(), { pixel->x(), pixel->y(), pixel->z() });
+
+                stream << "pixels " << index << ' ' << row_start << ' ' << row_end << ' '
+                       << sizeof(real) << '\n';
+                stream.write(reinterpret_cast<const char*>(values.data()), std::streamsize(values.size() * sizeof(real)));
+                stream.flush();
+                if (!stream) break;
+                tiles++;
+            }
+        }
+        timer.set("tiles", tiles);
+    }
+};
+
+// ------------------------------------------------------
+// tile_coordinator: spreads one image over the workers
+// that connect, and merges their tiles
+// ------------------------------------------------------
+class tile_coordinator {
+  public:
+    tile_coordinator(const camera& cam, const tile_settings& settings = {})
+        : cam(cam), settings(settings) {}
+
+    // Counts of the last render()
+    size_t workers = 0;     // Workers that connected
+    size_t lost = 0;        // Workers dropped (disconnected or timed out)
+    size_t copies = 0;      // Extra copies of tiles handed to idle workers
+
+    // --------------------------------------------------------
+    // render(port)
+    // Listens on 'port' until every tile has come back from a
+    // worker and returns the framebuffer (summed samples, as
+    // camera::render_framebuffer()); empty if the port cannot
+    // be opened
+    // --------------------------------------------------------
+    std::vector<color> render(int port) {
+        int height = cam.prepare();
+        framebuffer.assign(size_t(cam.image_width) * height, color(0, 0, 0));
+        tiles.clear();
+        for (int row = 0; row < height; row += settings.tile_rows)
+            tiles.push_back({ row, std::min(row + settings.tile_rows, height) });
+        remaining = tiles.size();
+        workers = lost = copies = 0;
+
+        std::ostringstream settings_text;
+        write_camera_settings(settings_text, cam);
+        camera_text = settings_text.str();
+
+        listener = tcp_listen(port);
+        if (listener < 0) {
+            std::cerr << "Coordinator: cannot listen on port " << port << "\n";
+            return {};
+        }
+
+        // Workers are accepted until the image is complete
+        std::vector<std::thread> threads;
+        std::thread acceptor([this, &threads] {
+            while (true) {
+                int fd = ::accept(listener, nullptr, nullptr);
+                if (fd < 0) break;  // Listener shut down
+                std::lock_guard<std::mutex> lock(mutex);
+                if (remaining == 0) {
+                    ::close(fd);
+                    break;
+                }
+                workers++;
+                connected.push_back(fd);
+                threads.emplace_back([this, fd] { serve_worker(fd); });
+            }
+        });
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [this] { return remaining == 0; });
+
+            // Wakes accept(), and workers still on a spare copy
+            ::shutdown(listener, SHUT_RDWR);
+            for (int fd : connected) ::shutdown(fd, SHUT_RDWR);
+        }
+        acceptor.join();
+        for (auto& thread : threads) thread.join();
+        ::close(listener);
+
+        return std::move(framebuffer);
+    }
+
+  private:
+    struct tile {
+        int row_start, row_end;
+        int rendering = 0;   // Workers on it now
+        bool done = false;
+    };
+
+    camera cam;
+    tile_settings settings;
+    std::string camera_text;
+    std::vector<color> framebuffer;
+    std::vector<tile> tiles;
+    size_t remaining = 0;
+    int listener = -1;
+    std::vector<int> connected;
+
+    std::mutex mutex;
+    std::condition_variable changed;    // A tile was taken, returned or merged
+    std::condition_variable finished;   // The last tile was merged
+
+    // --------------------------------------------------------
+    // Next tile for a worker: the first one nobody renders,
+    // else a copy of the unfinished tile with the fewest
+    // workers on it; waits while there is neither. Returns
+    // -1 once the image is complete.
+    // --------------------------------------------------------
+    int take_tile() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            if (remaining == 0) return -1;
+
+            int spare = -1;
+            for (size_t t = 0; t < tiles.size(); t++) {
+                if (tiles[t].done) continue;
+                if (tiles[t].rendering == 0) {
+                    tiles[t].rendering++;
+                    return int(t);
+                }
+                if (tiles[t].rendering < settings.max_copies &&
+                    (spare < 0 || tiles[t].rendering < tiles[spare].rendering))
+                    spare = int(t);
+            }
+            if (spare >= 0) {
+                tiles[spare].rendering++;
+                copies++;
+                return spare;
+            }
+            changed.wait(lock);
+        }
+    }
+
+    // Merges the pixels of tile 't' (unless a copy came first)
+    void finish_tile(int t, const std::vector<real>& values) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tile& done = tiles[size_t(t)];
+        done.rendering--;
+        if (!done.done) {
+            size_t first = size_t(done.row_start) * cam.image_width;
+            for (size_t k = 0; k * 3 < values.size(); k++)
+                framebuffer[first + k] = color(values[3 * k], values[3 * k + 1], values[3 * k + 2]);
+            done.done = true;
+            if (--remaining == 0) finished.notify_all();
+        }
+        changed.notify_all();
+    }
+
+    // Puts tile 't' back after its worker was lost
+    void return_tile(int t) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tiles[size_t(t)].rendering--;
+        changed.notify_all();
+    }
+
+    // --------------------------------------------------------
+    // One connected worker: its camera, then tiles until the
+    // image is complete or the worker fails
+    // --------------------------------------------------------
+    void serve_worker(int fd) {
+        timeval timeout;
+        timeout.tv_sec = long(settings.tile_timeout);
+        timeout.tv_usec = long((settings.tile_timeout - double(timeout.tv_sec)) * 1e6);
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        socket_buffer buffer(fd);
+        std::iostream stream(&buffer);
+        stream << "camera\n" << camera_text << "end\n" << std::flush;
+
+        std::vector<real> values;
+        int t;
+        while (stream && (t = take_tile()) >= 0) {
+            const tile& assigned = tiles[size_t(t)];
+            stream << "tile " << t << ' ' << assigned.row_start << ' ' << assigned.row_end << '\n' << std::flush;
+
+            // Header, then exactly the tile's pixels
+            std::string line, word;
+            int index = -1, row_start = -1, row_end = -1;
+            size_t value_size = 0;
+            if (std::getline(stream, line)) {
+                std::istringstream(line) >> word >> index >> row_start >> row_end >> value_size;
+            }
+            bool valid = word == "pixels" && index == t && row_start == assigned.row_start &&
+                         row_end == assigned.row_end && value_size == sizeof(real);
+            if (valid) {
+                values.resize(size_t(row_end - row_start) * cam.image_width * 3);
+                valid = bool(stream.read(reinterpret_cast<char*>(values.data()),
+                                         std::streamsize(values.size() * sizeof(real))));
+            }
+            if (!valid) {
+                return_tile(t);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (remaining > 0) lost++;  // Not just cut off at the end
+                break;
+            }
+            finish_tile(t, values);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        connected.erase(std::find(connected.begin(), connected.end(), fd));
+        ::close(fd);
+    }
+};
+
+#endif // _WIN32
+
+#endif // DISTRIBUTED_H
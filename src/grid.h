@@ -0,0 +1,291 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// ============================================================
+// uniform_grid: two-level uniform grid accelerator
+//
+// An alternative to bvh_node for many primitives of similar
+// size spread over a region (the spheres of many_spheres()).
+// The bounds are cut into equal cells, about 'density' cells
+// per primitive, and every cell lists the primitives whose
+// boxes overlap it:
+//
+//  - the build is linear: one pass counts the primitives per
+//    cell, a prefix sum places the lists, a second pass fills
+//    them; nothing is sorted
+//  - a ray walks the cells it crosses front to back with a 3D
+//    DDA (Amanatides & Woo 1987) and stops after the first
+//    cell whose primitives give a hit inside that cell
+//  - cells that still hold more than max_cell_items primitives
+//    (clumps) get a grid of their own; the nested grid is the
+//    cell's only item
+//  - primitives far larger than the typical one (a ground
+//    sphere) would stretch the bounds and fill every cell;
+//    they are kept out of the grid and tested by every ray
+//
+// A primitive that overlaps several cells is listed in each
+// and may be tested more than once along a ray. Closest hits
+// are the same as with a BVH.
+// ============================================================
+struct grid_settings {
+    double density = 2.0;          // Cells per primitive
+    int max_resolution = 128;      // Cells per axis
+    size_t max_cell_items = 12;    // More items than this get a nested grid
+    double large_factor = 16.0;    // Primitives this many times the median size stay out
+};
+
+class uniform_grid : public hittable {
+  public:
+    uniform_grid(const hittable_list& list, const grid_settings& settings = {})
+        : uniform_grid(list.objects, settings, aabb::universe, 0) {}
+
+    // --------------------------------------------------------
+    // Grid over 'objects' clipped to 'clip'. Nested grids
+    // (level 1) are clipped to their cell and never split
+    // further or set primitives aside.
+    // --------------------------------------------------------
+    uniform_grid(const std::vector<shared_ptr<hittable>>& objects, const grid_settings& settings,
+                 const aabb& clip, int level) {
+        // Primitive sizes: the longest side of each box
+        std::vector<real> sizes;
+        sizes.reserve(objects.size());
+        for (const auto& object : objects) sizes.push_back(longest_side(object->bounding_box()));
+
+        real large = std::numeric_limits<real>::infinity();
+        if (level == 0 && !sizes.empty()) {
+            std::vector<real> sorted(sizes);
+            std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+            large = real(settings.large_factor) * sorted[sorted.size() / 2];
+        }
+
+        std::vector<shared_ptr<hittable>> binned;
+        bbox = aabb::empty;
+        bounds = aabb::empty;
+        for (size_t i = 0; i < objects.size(); i++) {
+            aabb box = objects[i]->bounding_box();
+            bbox = aabb(bbox, box);
+            if (sizes[i] > large) {
+                unbinned.push_back(objects[i]);
+            } else {
+                binned.push_back(objects[i]);
+                bounds = aabb(bounds, box);
+            }
+        }
+        bounds = bounds.intersect(clip);
+        bbox = bbox.intersect(clip);
+        if (binned.empty() || bounds.is_empty()) return;
+
+        choose_resolution(binned.size(), settings.density, settings.max_resolution);
+        fill(binned);
+
+        if (level == 0) nest_crowded_cells(settings);
+    }
+
+    // --------------------------------------------------------
+    // Closest hit: the set-aside primitives first (they narrow
+    // the range), then the cells along the ray in order
+    // --------------------------------------------------------
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        bool hit_anything = false;
+        for (const auto& object : unbinned) {
+            if (object->hit(r, ray_t, rec)) {
+                hit_anything = true;
+                ray_t.max = rec.t;
+            }
+        }
+        if (cell_start.empty()) return hit_anything;
+
+        // Where the ray enters and leaves the grid
+        const vector3& origin = r.origin();
+        const vector3& direction = r.direction();
+        real t_enter = ray_t.min, t_leave = ray_t.max;
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& slab = bounds.axis_interval(axis);
+            real inv = 1 / direction[axis];
+            real t0 = (slab.min - origin[axis]) * inv;
+            real t1 = (slab.max - origin[axis]) * inv;
+            if (t0 > t1) std::swap(t0, t1);
+            t_enter = std::max(t_enter, t0);
+            t_leave = std::min(t_leave, t1 * aabb::exit_scale);
+            if (t_leave < t_enter) return hit_anything;
+        }
+
+        // DDA setup: the cell holding the entry point, the ray
+        // parameter at the next cell boundary on each axis, and
+        // the parameter distance between boundaries
+        int cell[3], step[3], end[3];
+        real next[3], delta[3];
+        for (int axis = 0; axis < 3; axis++) {
+            real min = bounds.axis_interval(axis).min;
+            real p = origin[axis] + t_enter * direction[axis];
+            cell[axis] = std::clamp(int((p - min) * inv_cell[axis]), 0, resolution[axis] - 1);
+
+            real d = direction[axis];
+            if (d > 0) {
+                step[axis] = 1;
+                end[axis] = resolution[axis];
+                next[axis] = (min + (cell[axis] + 1) * cell_size[axis] - origin[axis]) / d;
+                delta[axis] = cell_size[axis] / d;
+            } else if (d < 0) {
+                step[axis] = -1;
+                end[axis] = -1;
+                next[axis] = (min + cell[axis] * cell_size[axis] - origin[axis]) / d;
+                delta[axis] = -cell_size[axis] / d;
+            } else {
+                step[axis] = 0;
+                end[axis] = -1;
+                next[axis] = delta[axis] = std::numeric_limits<real>::infinity();
+            }
+        }
+
+        while (true) {
+            RT_COUNT(nodes_visited);
+            size_t index = (size_t(cell[2]) * resolution[1] + cell[1]) * resolution[0] + cell[0];
+            for (uint32_t k = cell_start[index]; k < cell_start[index + 1]; k++) {
+                if (items[k]->hit(r, ray_t, rec)) {
+                    hit_anything = true;
+                    ray_t.max = rec.t;
+                }
+            }
+
+            // A hit before the far side of this cell cannot be beaten
+            // by anything in the cells behind it
+            int axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+            real t_exit = next[axis];
+            if (ray_t.max <= t_exit || t_exit > t_leave) break;
+
+            cell[axis] += step[axis];
+            if (cell[axis] == end[axis]) break;
+            next[axis] += delta[axis];
+        }
+        return hit_anything;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    // Cells, non-empty cells, nested grids and set-aside primitives
+    size_t cell_count() const { return cell_start.empty() ? 0 : cell_start.size() - 1; }
+    size_t occupied_cells() const {
+        size_t occupied = 0;
+        for (size_t c = 0; c + 1 < cell_start.size(); c++) occupied += cell_start[c + 1] > cell_start[c];
+        return occupied;
+    }
+    size_t nested_grids() const { return nested; }
+    size_t unbinned_count() const { return unbinned.size(); }
+
+  private:
+    aabb bbox;                                  // Everything, set-aside primitives included
+    aabb bounds;                                // The cells
+    int resolution[3] = { 0, 0, 0 };
+    real cell_size[3], inv_cell[3];
+    std::vector<uint32_t> cell_start;           // Items of cell c: [cell_start[c], cell_start[c + 1])
+    std::vector<shared_ptr<hittable>> items;
+    std::vector<shared_ptr<hittable>> unbinned;
+    size_t nested = 0;
+
+    static real longest_side(const aabb& box) {
+        return std::max({ box.x.size(), box.y.size(), box.z.size() });
+    }
+
+    // --------------------------------------------------------
+    // Cubic-ish cells: about density * count of them over the
+    // bounds, with each axis cut in proportion to its length
+    // --------------------------------------------------------
+    void choose_resolution(size_t count, double density, int max_resolution) {
+        real extent[3] = { bounds.x.size(), bounds.y.size(), bounds.z.size() };
+        real longest = std::max({ extent[0], extent[1], extent[2] });
+        real volume = 1;
+        for (real e : extent) volume *= std::max(e, longest * real(1e-3));
+        real cells_per_unit = std::cbrt(real(density * count) / volume);
+
+        for (int axis = 0; axis < 3; axis++) {
+            resolution[axis] = std::clamp(int(std::ceil(extent[axis] * cells_per_unit)), 1, max_resolution);
+            cell_size[axis] = extent[axis] / resolution[axis];
+            inv_cell[axis] = cell_size[axis] > 0 ? 1 / cell_size[axis] : 0;
+        }
+    }
+
+    // Range of cells a box overlaps along 'axis' (padded by a
+    // hair, so rounding cannot leave a primitive out of a cell
+    // a ray crosses it in)
+    void cell_range(const aabb& box, int axis, int& first, int& last) const {
+        const interval& slab = box.axis_interval(axis);
+        real min = bounds.axis_interval(axis).min;
+        real pad = cell_size[axis] * real(1e-4);
+        first = std::clamp(int(std::floor((slab.min - pad - min) * inv_cell[axis])), 0, resolution[axis] - 1);
+        last  = std::clamp(int(std::floor((slab.max + pad - min) * inv_cell[axis])), 0, resolution[axis] - 1);
+    }
+
+    // Counting sort of the primitives into their cells
+    void fill(const std::vector<shared_ptr<hittable>>& objects) {
+        size_t cells = size_t(resolution[0]) * resolution[1] * resolution[2];
+        cell_start.assign(cells + 1, 0);
+
+        auto for_each_cell = [&](const aabb& box, auto&& visit) {
+            int first[3], last[3];
+            for (int axis = 0; axis < 3; axis++) cell_range(box, axis, first[axis], last[axis]);
+            for (int z = first[2]; z <= last[2]; z++)
+                for (int y = first[1]; y <= last[1]; y++)
+                    for (int x = first[0]; x <= last[0]; x++)
+                        visit((size_t(z) * resolution[1] + y) * resolution[0] + x);
+        };
+
+        for (const auto& object : objects)
+            for_each_cell(object->bounding_box(), [&](size_t c) { cell_start[c + 1]++; });
+        for (size_t c = 0; c < cells; c++) cell_start[c + 1] += cell_start[c];
+
+        items.resize(cell_start[cells]);
+        std::vector<uint32_t> cursor(cell_start.begin(), cell_start.end() - 1);
+        for (const auto& object : objects)
+            for_each_cell(object->bounding_box(), [&](size_t c) { items[cursor[c]++] = object; });
+    }
+
+    // --------------------------------------------------------
+    // Replaces the item list of every crowded cell with a grid
+    // over those items, clipped to the cell
+    // --------------------------------------------------------
+    void nest_crowded_cells(const grid_settings& settings) {
+        size_t cells = cell_count();
+        std::vector<uint32_t> starts(cells + 1, 0);
+        std::vector<shared_ptr<hittable>> compacted;
+        compacted.reserve(items.size());
+
+        for (size_t c = 0; c < cells; c++) {
+            auto first = items.begin() + cell_start[c], last = items.begin() + cell_start[c + 1];
+            if (size_t(last - first) > settings.max_cell_items) {
+                std::vector<shared_ptr<hittable>> crowd(first, last);
+                compacted.push_back(make_scene_object<uniform_grid>(crowd, settings, cell_box(c), 1));
+                nested++;
+            } else {
+                compacted.insert(compacted.end(), first, last);
+            }
+            starts[c + 1] = uint32_t(compacted.size());
+        }
+        items.swap(compacted);
+        cell_start.swap(starts);
+    }
+
+    aabb cell_box(size_t c) const {
+        int index[3] = { int(c % resolution[0]), int(c / resolution[0] % resolution[1]),
+                         int(c / (size_t(resolution[0]) * resolution[1])) };
+        aabb box;
+        interval* axes[3] = { &box.x, &box.y, &box.z };
+        for (int axis = 0; axis < 3; axis++) {
+            real min = bounds.axis_interval(axis).min;
+            *axes[axis] = interval(min + index[axis] * cell_size[axis], min + (index[axis] + 1) * cell_size[axis]);
+        }
+        return box;
+    }
+};
+
+#endif // GRID_H
@@ -0,0 +1,70 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "color.h"
+
+// ------------------------------------------------------
+// heat_color(t)
+// Maps t in [0,1] to a false color running
+// black -> blue -> magenta -> orange -> yellow -> white,
+// so cheap pixels are dark and expensive ones bright.
+// ------------------------------------------------------
+inline color heat_color(double t) {
+    static const color stops[] = {
+        color(0.00, 0.00, 0.00),
+        color(0.15, 0.05, 0.55),
+        color(0.70, 0.10, 0.55),
+        color(0.98, 0.45, 0.10),
+        color(0.99, 0.90, 0.20),
+        color(1.00, 1.00, 1.00)
+    };
+    const int segments = int(sizeof(stops) / sizeof(stops[0])) - 1;
+
+    t = std::clamp(t, 0.0, 1.0) * segments;
+    int k = std::min(int(t), segments - 1);
+    double f = t - k;
+    return (1 - f) * stops[k] + f * stops[k + 1];
+}
+
+// ------------------------------------------------------
+// write_cost_map(basename, width, height, cost)
+// Writes a per-pixel cost buffer (row-major, top row first)
+// as two files:
+//  - basename.pfm: raw 32-bit floats (Portable Float Map),
+//    for exact analysis in other tools
+//  - basename.ppm: false-color heatmap. Colors are scaled to
+//    the 99th percentile so a few outliers do not wash out
+//    the rest of the image.
+// ------------------------------------------------------
+inline void write_cost_map(const std::string& basename, int width, int height,
+                           const std::vector<float>& cost) {
+    // PFM stores rows bottom-to-top; a negative scale means little-endian
+    std::ofstream pfm(basename + ".pfm", std::ios::binary);
+    if (!pfm) {
+        std::cerr << "Failed to write cost map: " << basename << ".pfm\n";
+        return;
+    }
+    pfm << "Pf\n" << width << ' ' << height << "\n-1.0\n";
+    for (int j = height - 1; j >= 0; j--)
+        pfm.write(reinterpret_cast<const char*>(&cost[size_t(j) * width]),
+                  std::streamsize(sizeof(float)) * width);
+
+    std::vector<float> sorted(cost);
+    size_t p99 = std::min(sorted.size() - 1, sorted.size() * 99 / 100);
+    std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.end());
+    double scale = sorted[p99] > 0 ? 1.0 / sorted[p99] : 0;
+
+    std::ofstream ppm(basename + ".ppm");
+    ppm << "P3\n" << width << ' ' << height << "\n255\n";
+    for (float value : cost) {
+        color c = heat_color(value * scale);
+        ppm << int(255.999 * c.x()) << ' ' << int(255.999 * c.y()) << ' ' << int(255.999 * c.z()) << '\n';
+    }
+}
+
+#endif // HEATMAP_H
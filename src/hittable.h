@@ -1,9 +1,12 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
-#include "aabb.h"  // For axis-aligned bounding box (used in acceleration structures)
+#include "aabb.h"      // For axis-aligned bounding box (used in acceleration structures)
+#include "arena.h"     // Arena allocation of scene objects
+#include "counters.h"  // Traversal counters for diagnostics builds
 
 class material;    // Forward declaration to avoid circular include dependency
+struct ray_packet; // Defined in packet.h (included at the end of this file)
 
 // ------------------------------------------------------
 // Struct: hit_record
@@ -16,7 +19,7 @@ public:
     vector3 p;                      // Intersection point in 3D space
     vector3 normal;                 // Surface normal at the hit point
     shared_ptr<material> mat;       // Pointer to the material at the hit point
-    double t;                       // Ray parameter at the intersection: P(t) = origin + t * direction
+    real t;                         // Ray parameter at the intersection: P(t) = origin + t * direction
     bool front_face;                // True if the ray hits the front face of the surface
 
     // --------------------------------------
@@ -54,6 +57,29 @@ public:
     // Returns the axis-aligned bounding box for this object.
     // Used for BVH acceleration.
     virtual aabb bounding_box() const = 0;
+
+    // Returns the bounding box of the part of this object that lies
+    // inside 'clip'. Used by spatial-split BVH builders. The default
+    // is the conservative overlap of the two boxes; primitives can
+    // override it with an exact clip.
+    virtual aabb clipped_box(const aabb& clip) const {
+        return bounding_box().intersect(clip);
+    }
+
+    // Traces the rays of 'packet' listed in active[0..count) and
+    // updates each one's closest hit. The default traces them one
+    // by one; acceleration structures override it to traverse
+    // the packet as a whole.
+    virtual void hit_packet(ray_packet& packet, interval ray_t,
+                            const int* active, int count) const;
+
+    // Returns a copy of this object allocated from 'arena', or
+    // nullptr if the type cannot be copied. Used to lay a finished
+    // scene out in traversal order (bvh_node::relocate()); objects
+    // it references (materials, shared meshes) are not copied.
+    virtual shared_ptr<hittable> copy_into(scene_arena& /*arena*/) const { return nullptr; }
 };
 
+#include "packet.h"  // Needs the complete hittable; defines hit_packet()
+
 #endif // HITTABLE_H
@@ -1,28 +1,40 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <filesystem>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include "ray_tracer.h"
+#include "accelerator.h"
+#include "bvh.h"
 #include "hittable_list.h"
+#include "instance.h"
+#include "log.h"
 #include "material.h"
+#include "mesh.h"
+#include "paged_mesh.h"
 #include "sphere.h"
 #include "tri.h"
 
 // --------------------------------------
-// Load a Wavefront .OBJ file into the scene as triangles
+// Read the vertices and triangular faces of a Wavefront .OBJ file
 // Each 'v' line defines a vertex, and each 'f' line defines a triangle face by vertex indices
+// Faces that refer to missing vertices are skipped. Returns false if the file cannot be opened.
 // --------------------------------------
-void load_obj_file(const std::string& filename, hittable_list& scene, shared_ptr<material> mat) {
+bool read_obj_mesh(const std::string& filename, indexed_mesh& mesh) {
     std::ifstream file(filename);
     if (!file) {
         std::cerr << "Failed to open OBJ file: " << filename << "\n";
-        return;
+        return false;
     }
 
-    std::vector<vector3> vertices;
     std::string line;
-
     while (std::getline(file, line)) {
         std::istringstream iss(line);
         std::string token;
@@ -31,31 +43,147 @@ void load_obj_file(const std::string& filename, hittable_list& scene, shared_ptr
         if (token == "v") {  // Vertex definition
             double x, y, z;
             iss >> x >> y >> z;
-            vertices.emplace_back(x, y, z);
+            mesh.vertices.emplace_back(x, y, z);
         }
         else if (token == "f") {  // Face definition
-            int i1, i2, i3;
+            long i1 = 0, i2 = 0, i3 = 0;
             iss >> i1 >> i2 >> i3;
             // OBJ indices start at 1, so subtract 1
-            scene.add(make_shared<tri>(
-                vertices[i1 - 1],
-                vertices[i2 - 1],
-                vertices[i3 - 1],
-                mat
-            ));
+            long count = long(mesh.vertices.size());
+            if (i1 < 1 || i2 < 1 || i3 < 1 || i1 > count || i2 > count || i3 > count) continue;
+            mesh.faces.push_back({ uint32_t(i1 - 1), uint32_t(i2 - 1), uint32_t(i3 - 1) });
         }
     }
+    return true;
+}
+
+// --------------------------------------
+// Load a Wavefront .OBJ file into the scene as triangles
+// The mesh is cleaned up first (welding, degenerate and duplicate
+// faces, Morton order; see mesh.h). Returns what the cleanup did.
+// --------------------------------------
+mesh_cleanup_report load_obj_file(const std::string& filename, hittable_list& scene, shared_ptr<material> mat,
+                                  Logger* logger = nullptr, const mesh_cleanup_settings& cleanup = {}) {
+    // Time the load when a logger is given
+    std::optional<Logger::scoped_timer> timer;
+    if (logger) timer.emplace(*logger, "obj_load");
+
+    indexed_mesh mesh;
+    if (!read_obj_mesh(filename, mesh)) return {};
+
+    mesh_cleanup_report report;
+    {
+        std::optional<Logger::scoped_timer> cleanup_timer;
+        if (logger) cleanup_timer.emplace(*logger, "mesh_cleanup");
+        report = clean_mesh(mesh, cleanup);
+        if (cleanup_timer) {
+            cleanup_timer->set("welded_vertices", report.welded_vertices);
+            cleanup_timer->set("degenerate", report.degenerate_faces);
+            cleanup_timer->set("duplicates", report.duplicate_faces);
+        }
+    }
+    if (report.welded_vertices || report.removed_faces()) {
+        std::clog << filename << ": welded " << report.welded_vertices << " vertices, removed "
+                  << report.degenerate_faces << " degenerate and " << report.duplicate_faces
+                  << " duplicate triangles\n";
+    }
+
+    for (const auto& face : mesh.faces) {
+        scene.add(make_scene_object<tri>(
+            mesh.vertices[face[0]],
+            mesh.vertices[face[1]],
+            mesh.vertices[face[2]],
+            mat
+        ));
+    }
+
+    if (timer) {
+        timer->set("vertices", mesh.vertices.size());
+        timer->set("triangles", mesh.faces.size());
+    }
+    return report;
+}
+
+// --------------------------------------
+// Load a Wavefront .OBJ file as an out-of-core paged_mesh (see paged_mesh.h)
+// On first use, or when the OBJ is newer, the cleaned-up mesh is written to
+// "<filename>.paged"; later loads only map that file. Converting needs the
+// indexed mesh in memory (about 40 bytes per face, a fraction of the resident
+// triangles), rendering only the cache: cache_bytes bounds the resident clusters.
+// Returns nullptr if the OBJ cannot be read.
+// --------------------------------------
+shared_ptr<paged_mesh> load_paged_obj_file(const std::string& filename, shared_ptr<material> mat,
+                                           size_t cache_bytes, Logger* logger = nullptr) {
+    namespace fs = std::filesystem;
+    const std::string paged_path = filename + ".paged";
+
+    std::error_code error;
+    bool stale = !fs::exists(paged_path, error)
+              || fs::last_write_time(filename, error) > fs::last_write_time(paged_path, error);
+
+    shared_ptr<paged_mesh> mesh;
+    if (!stale) mesh = paged_mesh::open(paged_path, mat, cache_bytes);
+
+    // Missing, outdated or written by a build of another precision
+    if (!mesh) {
+        std::optional<Logger::scoped_timer> timer;
+        if (logger) timer.emplace(*logger, "paged_convert");
+
+        indexed_mesh source;
+        if (!read_obj_mesh(filename, source)) return nullptr;
+        clean_mesh(source);
+        if (!write_paged_mesh(source, paged_path)) return nullptr;
+        if (timer) timer->set("triangles", source.faces.size());
+
+        mesh = paged_mesh::open(paged_path, mat, cache_bytes);
+        if (!mesh) std::cerr << "Failed to open paged mesh: " << paged_path << "\n";
+    }
+    return mesh;
+}
+
+// --------------------------------------
+// Parse a material description: MATERIAL r g b [fuzz]
+// Returns nullptr (and reports the error) for unknown material types
+// --------------------------------------
+shared_ptr<material> parse_material(std::istringstream& iss) {
+    std::string mat_type;
+    double r, g, b;
+
+    iss >> mat_type >> r >> g >> b;
+
+    if (mat_type == "lambertian") {
+        return make_shared<lambertian>(color(r, g, b));
+    } else if (mat_type == "metal") {
+        double fuzz;
+        iss >> fuzz;
+        return make_shared<metal>(color(r, g, b), fuzz);
+    } else if (mat_type == "light") {
+        return make_shared<diffuse_light>(color(r, g, b));
+    }
+
+    std::cerr << "Unknown material type: " << mat_type << "\n";
+    return nullptr;
 }
 
 // --------------------------------------
 // Load a scene from a plain-text description file
-// Supports "sphere" and "obj" entries with associated material definitions
+// Supports "sphere", "obj", "paged" and "instance" entries with associated material definitions
+//
+// "instance" lines share one bottom-level BVH per OBJ path, so placing the
+// same mesh many times costs one load and one build plus a small transform each
+//
+// An "accelerator bvh|grid|auto" line picks the structure built over the
+// scene (see accelerator.h); it is stored in *accelerator when given
 // --------------------------------------
-hittable_list load_scene_from_file(const std::string& filename) {
+hittable_list load_scene_from_file(const std::string& filename, Logger* logger = nullptr,
+                                   accelerator_type* accelerator = nullptr) {
     hittable_list scene;
     std::ifstream file(filename);
     std::string line;
 
+    // Bottom-level BVHs of meshes used by "instance" lines, keyed by path
+    std::map<std::string, shared_ptr<hittable>> meshes;
+
     while (std::getline(file, line)) {
         if (line.empty()) continue;
         std::istringstream iss(line);
@@ -66,53 +194,78 @@ hittable_list load_scene_from_file(const std::string& filename) {
         if (type == "sphere") {
             // Format: sphere x y z radius mat_type r g b [fuzz]
             double x, y, z, radius;
-            std::string mat_type;
-            double r, g, b;
-
-            iss >> x >> y >> z >> radius >> mat_type >> r >> g >> b;
-
-            shared_ptr<material> mat;
-
-            if (mat_type == "lambertian") {
-                mat = make_shared<lambertian>(color(r, g, b));
-            } else if (mat_type == "metal") {
-                double fuzz;
-                iss >> fuzz;
-                mat = make_shared<metal>(color(r, g, b), fuzz);
-            } else if (mat_type == "light") {
-                mat = make_shared<diffuse_light>(color(r, g, b));
-            } else {
-                std::cerr << "Unknown material type: " << mat_type << "\n";
-                continue;
-            }
+            iss >> x >> y >> z >> radius;
+
+            auto mat = parse_material(iss);
+            if (!mat) continue;
 
-            scene.add(make_shared<sphere>(vector3(x, y, z), radius, mat));
+            scene.add(make_scene_object<sphere>(vector3(x, y, z), radius, mat));
         } 
         else if (type == "obj") {
             // Format: obj path_to_file.obj mat_type r g b [fuzz]
             std::string obj_path;
-            std::string mat_type;
-            double r, g, b;
-
-            iss >> obj_path >> mat_type >> r >> g >> b;
-
-            shared_ptr<material> mat;
-
-            if (mat_type == "lambertian") {
-                mat = make_shared<lambertian>(color(r, g, b));
-            } else if (mat_type == "metal") {
-                double fuzz;
-                iss >> fuzz;
-                mat = make_shared<metal>(color(r, g, b), fuzz);
-            } else if (mat_type == "light") {
-                mat = make_shared<diffuse_light>(color(r, g, b));
-            } else {
-                std::cerr << "Unknown material type: " << mat_type << "\n";
-                continue;
-            }
+            iss >> obj_path;
 
-            load_obj_file(obj_path, scene, mat);
+            auto mat = parse_material(iss);
+            if (!mat) continue;
+
+            load_obj_file(obj_path, scene, mat, logger);
         } 
+        else if (type == "paged") {
+            // Format: paged path_to_file.obj cache_mb mat_type r g b [fuzz]
+            // Out-of-core mesh with at most cache_mb megabytes of triangles in memory
+            std::string obj_path;
+            double cache_mb;
+            iss >> obj_path >> cache_mb;
+
+            auto mat = parse_material(iss);
+            if (!mat) continue;
+
+            auto mesh = load_paged_obj_file(obj_path, mat, size_t(cache_mb * 1024 * 1024), logger);
+            if (mesh) scene.add(mesh);
+        }
+        else if (type == "instance") {
+            // Format: instance path_to_file.obj tx ty tz rx ry rz scale mat_type r g b [fuzz]
+            // Rotations are in degrees, applied about x, then y, then z
+            std::string obj_path;
+            double tx, ty, tz, rx, ry, rz, s;
+            iss >> obj_path >> tx >> ty >> tz >> rx >> ry >> rz >> s;
+
+            auto mat = parse_material(iss);
+            if (!mat) continue;
+
+            auto& mesh = meshes[obj_path];
+            if (!mesh) {
+                // Triangles carry no material; each instance supplies its own
+                hittable_list triangles;
+                load_obj_file(obj_path, triangles, nullptr, logger);
+                if (triangles.objects.empty()) {
+                    meshes.erase(obj_path);
+                    continue;
+                }
+                mesh = make_scene_object<bvh_node>(triangles);
+            }
+
+            auto placement = transform::translate(vector3(tx, ty, tz))
+                           * transform::rotate_z(rz)
+                           * transform::rotate_y(ry)
+                           * transform::rotate_x(rx)
+                           * transform::scale(vector3(s, s, s));
+
+            scene.add(make_scene_object<instance>(mesh, placement, mat));
+        }
+        else if (type == "accelerator") {
+            // Format: accelerator bvh|grid|auto
+            std::string name;
+            iss >> name;
+
+            accelerator_type choice;
+            if (!parse_accelerator(name, choice)) {
+                std::cerr << "Unknown accelerator: " << name << "\n";
+                continue;
+            }
+            if (accelerator) *accelerator = choice;
+        }
         else {
             std::cerr << "Unknown object type: " << type << "\n";
         }
@@ -121,10 +274,92 @@ hittable_list load_scene_from_file(const std::string& filename) {
     return scene;
 }
 
+// --------------------------------------
+// Read the value of one camera setting 'key' from 'in' into 'cam'
+// Returns false (and reads nothing) if the key is not a camera setting
+// --------------------------------------
+bool read_camera_setting(std::istream& in, const std::string& key, camera& cam) {
+    if (key == "aspect_ratio") {
+        in >> cam.aspect_ratio;
+    } else if (key == "image_width") {
+        in >> cam.image_width;
+    } else if (key == "samples_per_pixel") {
+        in >> cam.samples_per_pixel;
+    } else if (key == "max_depth") {
+        in >> cam.max_depth;
+    } else if (key == "vfov") {
+        in >> cam.vfov;
+    } else if (key == "lookfrom") {
+        double x, y, z;
+        in >> x >> y >> z;
+        cam.lookfrom = vector3(x, y, z);
+    } else if (key == "lookat") {
+        double x, y, z;
+        in >> x >> y >> z;
+        cam.lookat = vector3(x, y, z);
+    } else if (key == "vup") {
+        double x, y, z;
+        in >> x >> y >> z;
+        cam.vup = vector3(x, y, z);
+    } else if (key == "seed") {
+        in >> cam.seed;
+    } else if (key == "packet_size") {
+        in >> cam.packet_size;
+    } else if (key == "wavefront") {
+        in >> cam.wavefront;
+    } else if (key == "reorder_rays") {
+        in >> cam.reorder_rays;
+    } else if (key == "cost_map") {
+        in >> cam.cost_map;
+    } else if (key == "cost_metric") {
+        std::string metric;
+        in >> metric;
+        cam.cost_type = (metric == "traversal") ? cost_metric::traversal : cost_metric::time;
+    } else if (key == "background") {
+        double r, g, b;
+        in >> r >> g >> b;
+        cam.background = color(r, g, b);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// --------------------------------------
+// Write the settings of 'cam' in the format read_camera_setting() reads,
+// with enough digits that reading them back gives the same camera
+// --------------------------------------
+void write_camera_settings(std::ostream& out, const camera& cam) {
+    auto old_precision = out.precision(std::numeric_limits<double>::max_digits10);
+    auto write_vector = [&out](const char* key, const vector3& v) {
+        out << key << ' ' << double(v.x()) << ' ' << double(v.y()) << ' ' << double(v.z()) << '\n';
+    };
+
+    out << "aspect_ratio " << cam.aspect_ratio << '\n'
+        << "image_width " << cam.image_width << '\n'
+        << "samples_per_pixel " << cam.samples_per_pixel << '\n'
+        << "max_depth " << cam.max_depth << '\n'
+        << "vfov " << cam.vfov << '\n';
+    write_vector("lookfrom", cam.lookfrom);
+    write_vector("lookat", cam.lookat);
+    write_vector("vup", cam.vup);
+    write_vector("background", cam.background);
+    out << "seed " << cam.seed << '\n'
+        << "packet_size " << cam.packet_size << '\n'
+        << "wavefront " << cam.wavefront << '\n'
+        << "reorder_rays " << cam.reorder_rays << '\n';
+    if (!cam.cost_map.empty()) {
+        out << "cost_map " << cam.cost_map << '\n'
+            << "cost_metric " << (cam.cost_type == cost_metric::traversal ? "traversal" : "time") << '\n';
+    }
+    out.precision(old_precision);
+}
+
 // --------------------------------------
 // Load camera settings from a plain-text configuration file
 // Recognized keys: aspect_ratio, image_width, samples_per_pixel, max_depth,
-// vfov, lookfrom, lookat, vup, background
+// vfov, lookfrom, lookat, vup, background, seed, packet_size, wavefront,
+// reorder_rays, cost_map, cost_metric
 // --------------------------------------
 void set_camera(const std::string& filename, camera& cam) {
     std::ifstream file(filename);
@@ -135,33 +370,7 @@ void set_camera(const std::string& filename, camera& cam) {
 
     std::string key;
     while (file >> key) {
-        if (key == "aspect_ratio") {
-            file >> cam.aspect_ratio;
-        } else if (key == "image_width") {
-            file >> cam.image_width;
-        } else if (key == "samples_per_pixel") {
-            file >> cam.samples_per_pixel;
-        } else if (key == "max_depth") {
-            file >> cam.max_depth;
-        } else if (key == "vfov") {
-            file >> cam.vfov;
-        } else if (key == "lookfrom") {
-            double x, y, z;
-            file >> x >> y >> z;
-            cam.lookfrom = vector3(x, y, z);
-        } else if (key == "lookat") {
-            double x, y, z;
-            file >> x >> y >> z;
-            cam.lookat = vector3(x, y, z);
-        } else if (key == "vup") {
-            double x, y, z;
-            file >> x >> y >> z;
-            cam.vup = vector3(x, y, z);
-        } else if (key == "background") {
-            double r, g, b;
-            file >> r >> g >> b;
-            cam.background = color(r, g, b);
-        } else {
+        if (!read_camera_setting(file, key, cam)) {
             // Skip unknown settings to allow forward compatibility
             std::cerr << "Unknown camera setting: " << key << "\n";
             std::string dummy;
@@ -169,3 +378,5 @@ void set_camera(const std::string& filename, camera& cam) {
         }
     }
 }
+
+#endif // INPUT_H
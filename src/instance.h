@@ -0,0 +1,108 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "hittable.h"
+#include "transform.h"
+
+// ------------------------------------------------------
+// Class: instance
+// Places a shared object (usually the bottom-level BVH of
+// a mesh) into the scene with an affine transform.
+//
+// Many instances can point at the same object, so a mesh
+// placed N times is loaded and BVH-built only once. The
+// scene's own bvh_node acts as the top-level BVH over the
+// instances.
+//
+// Rays are moved into object space for the intersection
+// test, and the hit point and normal are moved back.
+// ------------------------------------------------------
+class instance : public hittable {
+public:
+    // ------------------------------------------------------
+    // Constructor
+    // object:          shared geometry in object space
+    // object_to_world: placement of this copy in the scene
+    // mat:             material override (nullptr keeps the
+    //                  material stored in the object)
+    // ------------------------------------------------------
+    instance(shared_ptr<hittable> object, const transform& object_to_world,
+             shared_ptr<material> mat = nullptr)
+        : object(object), mat(mat)
+    {
+        set_transform(object_to_world);
+    }
+
+    // ------------------------------------------------------
+    // set_transform()
+    // Moves the instance and recomputes its world-space
+    // bounding box. Cheap enough to call every frame.
+    // ------------------------------------------------------
+    void set_transform(const transform& object_to_world) {
+        to_world = object_to_world;
+        to_object = object_to_world.inverse();
+        set_bounding_box();
+    }
+
+    // ------------------------------------------------------
+    // hit()
+    // Transforms the ray into object space and tests the
+    // shared object. The direction is not renormalized, so
+    // the ray parameter t is the same in both spaces.
+    // ------------------------------------------------------
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        ray local(to_object.point(r.origin()), to_object.vector(r.direction()));
+
+        if (!object->hit(local, ray_t, rec))
+            return false;
+
+        // Back to world space. Normals use the inverse transpose;
+        // the front/back orientation is unchanged by the transform.
+        rec.p = to_world.point(rec.p);
+        rec.normal = to_object.transposed_vector(rec.normal).normalize();
+
+        if (mat)
+            rec.mat = mat;
+
+        return true;
+    }
+
+    // Return the world-space bounding box
+    aabb bounding_box() const override { return bbox; }
+
+    // The copy shares the object-space geometry with this instance
+    shared_ptr<hittable> copy_into(scene_arena& arena) const override {
+        return arena.make<instance>(*this);
+    }
+
+private:
+    shared_ptr<hittable> object;  // Shared object-space geometry
+    shared_ptr<material> mat;     // Optional material override
+    transform to_world;           // Object space -> world space
+    transform to_object;          // World space -> object space
+    aabb bbox;                    // World-space bounding box
+
+    // ------------------------------------------------------
+    // set_bounding_box()
+    // Transforms the 8 corners of the object's box and
+    // takes the box around them.
+    // ------------------------------------------------------
+    void set_bounding_box() {
+        aabb local = object->bounding_box();
+        bbox = aabb::empty;
+
+        for (int i = 0; i < 2; i++) {
+            for (int j = 0; j < 2; j++) {
+                for (int k = 0; k < 2; k++) {
+                    vector3 corner(i ? local.x.max : local.x.min,
+                                   j ? local.y.max : local.y.min,
+                                   k ? local.z.max : local.z.min);
+                    vector3 p = to_world.point(corner);
+                    bbox = aabb(bbox, aabb(p, p));
+                }
+            }
+        }
+    }
+};
+
+#endif // INSTANCE_H
@@ -3,58 +3,64 @@
 
 // Represents a closed interval [min, max] on the real number line.
 // Used for bounding boxes, hit ranges, and value clamping.
-class interval {
+// T is the scalar type; the renderer uses interval = basic_interval<real>.
+template <typename T>
+class basic_interval {
     public:
-    double min, max; // Bounds of the interval
+    T min, max; // Bounds of the interval
 
     // Default constructor: creates an empty interval (min > max).
-    interval() : min(+infinity), max(-infinity) {}
+    basic_interval() : min(+infinity), max(-infinity) {}
 
     // Construct interval from given min and max.
-    interval(double min, double max) : min(min), max(max) {}
+    basic_interval(T min, T max) : min(min), max(max) {}
 
     // Construct the smallest interval enclosing both input intervals.
-    interval(const interval& a, const interval& b) {
+    basic_interval(const basic_interval& a, const basic_interval& b) {
         min = a.min <= b.min ? a.min : b.min;
         max = a.max >= b.max ? a.max : b.max;
     }
     
     // Length of the interval.
-    double size() const {
+    T size() const {
         return max - min;
     }
 
     // Returns true if x lies within [min, max].
-    bool contains(double x) const {
+    bool contains(T x) const {
         return min <= x && x <= max;
     }
 
     // Returns true if x lies strictly inside (min, max).
-    bool surrounds(double x) const {
+    bool surrounds(T x) const {
         return min < x && x < max;
     }
 
     // Clamps a value to the [min, max] range.
-    double clamp(double x) const {
+    T clamp(T x) const {
         if (x < min) return min;
         if (x > max) return max;
         return x;
     }
 
     // Returns an interval expanded by delta (split equally on both sides).
-    interval expand(double delta) const {
+    basic_interval expand(T delta) const {
         auto padding = delta/2;
-        return interval(min - padding, max + padding);
+        return basic_interval(min - padding, max + padding);
     }
 
     // Predefined constants for convenience.
-    static const interval empty, universe;
+    static const basic_interval empty, universe;
 };
 
 // Empty interval constant: no values inside.
-const interval interval::empty    = interval(+infinity, -infinity);
+template <typename T>
+const basic_interval<T> basic_interval<T>::empty    = basic_interval<T>(+infinity, -infinity);
 
 // Universe interval: contains all real numbers.
-const interval interval::universe = interval(-infinity, +infinity);
+template <typename T>
+const basic_interval<T> basic_interval<T>::universe = basic_interval<T>(-infinity, +infinity);
+
+using interval = basic_interval<real>;
 
 #endif
@@ -0,0 +1,175 @@
+#ifndef LAZY_BVH_H
+#define LAZY_BVH_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// ============================================================
+// Lazy BVH construction
+//
+// bvh_node builds the whole tree before the first ray is
+// traced. In a large scene seen from one camera much of that
+// tree is never visited: geometry behind the camera, or hidden
+// behind closer surfaces. make_lazy_bvh() builds only the top
+// of the tree up front:
+//
+//  - the top levels split their ranges at the median along the
+//    longest axis, as bvh_node does (with a partial sort, since
+//    each range only needs its two halves)
+//  - below them, each range becomes a lazy_subtree that holds
+//    its primitives and their bounds, and builds its bvh_node
+//    the first time a ray enters those bounds
+//
+// Each subtree is built exactly once (std::call_once); render
+// threads that reach it meanwhile wait for the build and then
+// traverse the finished subtree. Deferred subtrees are ordinary
+// median-split trees over the same ranges, so the image is the
+// one the eagerly built BVH gives.
+// ============================================================
+struct lazy_bvh_settings {
+    int eager_depth = -1;        // Levels built up front; < 0 picks half the depth of the tree
+    size_t min_deferred = 64;    // Smaller ranges are built up front
+};
+
+// ------------------------------------------------------
+// lazy_subtree: a BVH subtree built on first use
+// ------------------------------------------------------
+class lazy_subtree : public hittable {
+  public:
+    lazy_subtree(std::vector<shared_ptr<hittable>> objects, const aabb& bounds)
+        : objects(std::move(objects)), bbox(bounds), primitives(this->objects.size()) {}
+
+    // Until the subtree exists, only rays that enter its box
+    // build it; afterwards the subtree tests the box itself
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!built.load(std::memory_order_acquire)) {
+            RT_COUNT(boxes_tested);
+            if (!bbox.hit(r, ray_t)) return false;
+            build();
+        }
+        return subtree->hit(r, ray_t, rec);
+    }
+
+    void hit_packet(ray_packet& packet, interval ray_t,
+                    const int* active, int count) const override {
+        if (!built.load(std::memory_order_acquire)) {
+            bool entered = false;
+            for (int n = 0; n < count && !entered; n++) {
+                RT_COUNT(boxes_tested);
+                entered = bbox.hit(packet.rays[active[n]], interval(ray_t.min, packet.t_max[active[n]]));
+            }
+            if (!entered) return;
+            build();
+        }
+        subtree->hit_packet(packet, ray_t, active, count);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    // Number of primitives below this subtree, and whether it has been built
+    size_t size() const { return primitives; }
+    bool is_built() const { return built.load(std::memory_order_acquire); }
+
+    // Builds the subtree now if no ray has done so yet
+    void build() const {
+        std::call_once(once, [this] {
+            subtree = make_scene_object<bvh_node>(objects, 0, objects.size());
+            std::vector<shared_ptr<hittable>>().swap(objects);  // Now held by the subtree
+            built.store(true, std::memory_order_release);
+        });
+    }
+
+  private:
+    mutable std::vector<shared_ptr<hittable>> objects;  // Until built
+    mutable shared_ptr<bvh_node> subtree;               // Once built
+    mutable std::once_flag once;
+    mutable std::atomic<bool> built{false};
+    aabb bbox;
+    size_t primitives;
+};
+
+namespace lazy_bvh_detail {
+
+// --------------------------------------------------------
+// Emits the tree over objects[start, end) at 'depth': ranges
+// at eager_depth become lazy subtrees, small ones are built
+// in full, the others are split at the median like bvh_node
+// --------------------------------------------------------
+inline shared_ptr<hittable> emit(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end,
+                                 int depth, const lazy_bvh_settings& settings) {
+    size_t span = end - start;
+    if (span < std::max<size_t>(settings.min_deferred, 3))
+        return make_scene_object<bvh_node>(objects, start, end);
+
+    aabb bbox = aabb::empty;
+    for (size_t i = start; i < end; i++) bbox = aabb(bbox, objects[i]->bounding_box());
+
+    if (depth >= settings.eager_depth && depth > 0) {
+        return make_scene_object<lazy_subtree>(
+            std::vector<shared_ptr<hittable>>(objects.begin() + start, objects.begin() + end), bbox);
+    }
+
+    int axis = bbox.longest_axis();
+    size_t mid = start + span / 2;
+    std::nth_element(objects.begin() + start, objects.begin() + mid, objects.begin() + end,
+        [axis](const shared_ptr<hittable>& a, const shared_ptr<hittable>& b) {
+            return a->bounding_box().axis_interval(axis).min < b->bounding_box().axis_interval(axis).min;
+        });
+
+    return make_scene_object<bvh_node>(emit(objects, start, mid, depth + 1, settings),
+                                       emit(objects, mid, end, depth + 1, settings));
+}
+
+} // namespace lazy_bvh_detail
+
+// ------------------------------------------------------
+// make_lazy_bvh(list, settings)
+// Builds the top of a BVH over 'list' and defers the rest
+// (see above). The root is always built.
+// ------------------------------------------------------
+inline shared_ptr<bvh_node> make_lazy_bvh(hittable_list list, lazy_bvh_settings settings = {}) {
+    if (settings.eager_depth < 0) {
+        int depth = 0;
+        while ((size_t(1) << depth) < list.objects.size()) depth++;
+        settings.eager_depth = (depth + 1) / 2;
+    }
+
+    auto root = lazy_bvh_detail::emit(list.objects, 0, list.objects.size(), 0, settings);
+    return std::static_pointer_cast<bvh_node>(root);
+}
+
+// ------------------------------------------------------
+// How much of a lazy BVH has been built so far
+// ------------------------------------------------------
+struct lazy_bvh_progress {
+    size_t subtrees = 0, built = 0;                  // Deferred subtrees
+    size_t primitives = 0, built_primitives = 0;     // Primitives below them
+
+    explicit lazy_bvh_progress(const bvh_node& root) { visit(root); }
+
+  private:
+    void visit(const bvh_node& node) {
+        for (const auto& child : { node.left_child(), node.right_child() }) {
+            if (auto inner = dynamic_cast<const bvh_node*>(child.get())) {
+                visit(*inner);
+            } else if (auto lazy = dynamic_cast<const lazy_subtree*>(child.get())) {
+                subtrees++;
+                primitives += lazy->size();
+                if (lazy->is_built()) {
+                    built++;
+                    built_primitives += lazy->size();
+                }
+            }
+            if (node.right_child() == node.left_child()) break;
+        }
+    }
+};
+
+#endif // LAZY_BVH_H
@@ -1,34 +1,217 @@
 #ifndef LOG_H
 #define LOG_H
 
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
 #include <fstream>
+#include <mutex>
+#include <sstream>
 #include <string>
-#include <ctime>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// ------------------------------------------------------
+// peak_rss_kb()
+// Peak resident memory of this process in kilobytes
+// (0 if the platform does not report it).
+// ------------------------------------------------------
+inline uint64_t peak_rss_kb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return uint64_t(counters.PeakWorkingSetSize) / 1024;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return uint64_t(usage.ru_maxrss) / 1024; // Bytes on macOS
+#else
+    return uint64_t(usage.ru_maxrss);        // Kilobytes on Linux
+#endif
+#endif
+}
 
+// ------------------------------------------------------
+// Class: Logger
+// Writes structured log entries as JSON lines (one JSON
+// object per line) so they can be ingested by dashboards.
+//
+// Entries are buffered in memory and written in one go
+// when the buffer grows large, on flush(), or when the
+// logger is destroyed, so logging stays out of the way of
+// the renderer. Every entry carries a millisecond timestamp.
+//
+// Two kinds of entries:
+//  - log(message):     {"time": ..., "event": "message", "message": ...}
+//  - phase(name):      a scoped timer; when it goes out of scope it
+//                      writes {"time": ..., "event": "phase", "phase": name,
+//                      "duration_ms": ..., "peak_rss_kb": ..., <fields>}
+// ------------------------------------------------------
 class Logger {
 public:
+    // --------------------------------------------------
+    // Class: scoped_timer
+    // Times a phase with a high-resolution clock from
+    // construction until destruction. Extra fields such as
+    // primitive or ray counts can be attached meanwhile.
+    // --------------------------------------------------
+    class scoped_timer {
+    public:
+        scoped_timer(Logger& logger, const std::string& phase)
+            : logger(logger), phase(phase), start(std::chrono::steady_clock::now()) {}
+
+        scoped_timer(const scoped_timer&) = delete;
+        scoped_timer& operator=(const scoped_timer&) = delete;
+
+        ~scoped_timer() {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            double seconds = elapsed.count();
+
+            std::string entry = "\"event\": \"phase\", \"phase\": " + quote(phase)
+                              + ", \"duration_ms\": " + number(seconds * 1000.0);
+            for (const auto& [key, value] : counts) {
+                entry += ", " + quote(key) + ": " + number(value);
+                if (key == "rays" && seconds > 0)
+                    entry += ", \"rays_per_second\": " + number(value / seconds);
+            }
+            entry += ", \"peak_rss_kb\": " + std::to_string(peak_rss_kb());
+
+            logger.write_entry(entry);
+        }
+
+        // Attach a numeric field to the entry. A field named "rays"
+        // also produces "rays_per_second" from the phase duration.
+        template <typename T>
+        void set(const std::string& key, T value) {
+            static_assert(std::is_arithmetic<T>::value, "phase fields are numeric");
+            counts.emplace_back(key, double(value));
+        }
+
+    private:
+        Logger& logger;
+        std::string phase;
+        std::chrono::steady_clock::time_point start;
+        std::vector<std::pair<std::string, double>> counts;
+    };
+
     Logger(const std::string& filename = "render.log") {
         log_file.open(filename, std::ios::app);  // Append mode
     }
 
     ~Logger() {
+        flush();
         if (log_file.is_open()) {
             log_file.close();
         }
     }
 
+    // Log a plain message
     void log(const std::string& message) {
-        if (!log_file.is_open()) return;
+        write_entry("\"event\": \"message\", \"message\": " + quote(message));
+    }
 
-        auto now = std::time(nullptr);
-        char time_buf[100];
-        std::strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+    // Start timing a phase; the entry is written when the timer is destroyed
+    scoped_timer phase(const std::string& name) {
+        return scoped_timer(*this, name);
+    }
 
-        log_file << "[" << time_buf << "] " << message << "\n";
+    // Write all buffered entries to the file
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!log_file.is_open() || buffer.empty()) return;
+        log_file << buffer;
+        log_file.flush();
+        buffer.clear();
     }
 
 private:
     std::ofstream log_file;
+    std::string buffer;   // Pending JSON lines
+    std::mutex mutex;     // Entries may come from several threads
+
+    static constexpr size_t flush_threshold = 64 * 1024;
+
+    // Append one entry (the JSON fields without braces) with a timestamp
+    void write_entry(const std::string& fields) {
+        std::string line = "{\"time\": " + quote(timestamp()) + ", " + fields + "}\n";
+
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffer += line;
+            full = buffer.size() >= flush_threshold;
+        }
+        if (full) flush();
+    }
+
+    // Local time as YYYY-MM-DDTHH:MM:SS.mmm. Uses the reentrant
+    // localtime_r/localtime_s: entries come from several threads,
+    // and std::localtime returns a shared buffer.
+    static std::string timestamp() {
+        auto now = std::chrono::system_clock::now();
+        auto seconds = std::chrono::system_clock::to_time_t(now);
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          now.time_since_epoch()).count() % 1000;
+
+        std::tm local{};
+#ifdef _WIN32
+        localtime_s(&local, &seconds);
+#else
+        localtime_r(&seconds, &local);
+#endif
+        char time_buf[100];
+        std::strftime(time_buf, sizeof(time_buf), "%Y-%m-%dT%H:%M:%S", &local);
+
+        char result[120];
+        std::snprintf(result, sizeof(result), "%s.%03d", time_buf, int(millis));
+        return result;
+    }
+
+    // JSON string literal with escaping
+    static std::string quote(const std::string& text) {
+        std::string out = "\"";
+        for (char c : text) {
+            switch (c) {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n";  break;
+                case '\t': out += "\\t";  break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char code[8];
+                        std::snprintf(code, sizeof(code), "\\u%04x", c);
+                        out += code;
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        return out + "\"";
+    }
+
+    // JSON number (integers print without a fraction)
+    static std::string number(double value) {
+        std::ostringstream out;
+        bool integral = std::fabs(value) < 1e15 && value == double(int64_t(value));
+        out.precision(integral ? 20 : 6);
+        out << value;
+        return out.str();
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,8 @@
 #include "ray_tracer.h"
 
+#include "accelerator.h"
 #include "bvh.h"
+#include "bvh_stats.h"
 #include "camera.h"
 #include "hittable.h"
 #include "hittable_list.h"
@@ -8,180 +10,408 @@
 #include "sphere.h"
 #include "tri.h"
 #include "input.h"
+#include "instance.h"
+#include "distributed.h"
 #include "log.h"
+#include "render_daemon.h"
+#include "scenes.h"
+#include "static_scene.h"
+
+#include <chrono>
+#include <fstream>
+#include <optional>
+#include <string>
+
+// --------------------------------------
+// Render with phase timing: trace into a framebuffer on all threads
+// ("render", with ray counts), then write the PPM ("image_write")
+// --------------------------------------
+template <typename Scene>
+void render_timed(camera& cam, const Scene& world, Logger& logger,
+                  std::ostream& out = std::cout) {
+    std::vector<color> framebuffer;
+    {
+        auto timer = logger.phase("render");
+        uint64_t rays_before = total_rays_traced();
+        framebuffer = cam.render_framebuffer(world);
+        timer.set("rays", total_rays_traced() - rays_before);
+    }
+
+    auto timer = logger.phase("image_write");
+    cam.write_image(framebuffer, out);
+}
+
+// --------------------------------------
+// Sequential render timed as one phase (tracing and writing interleave)
+// --------------------------------------
+template <typename Scene>
+void render_sequential_timed(camera& cam, const Scene& world, Logger& logger) {
+    auto timer = logger.phase("render");
+    uint64_t rays_before = total_rays_traced();
+    cam.render(world);
+    timer.set("rays", total_rays_traced() - rays_before);
+}
 
 // --------------------------------------
 // Scene: Many Spheres
-// Creates a ground plane sphere and a grid of random spheres
-// with either diffuse or metallic materials, then renders the scene.
+// Builds the scene from scenes.h behind a BVH or a uniform grid,
+// whichever choose_accelerator() picks, then renders it.
 // --------------------------------------
-void many_spheres() {
+void many_spheres(Logger& logger) {
     hittable_list scene;
+    camera cam;
+    {
+        auto timer = logger.phase("scene_build");
+        many_spheres_scene(scene, cam);
+        timer.set("primitives", scene.objects.size());
+    }
 
-    // Ground material (large sphere as the floor)
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    scene.add(make_shared<sphere>(vector3(0,-1000,0), 1000, ground_material));
-
-    // Generate random small spheres
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            auto choose_mat = random_double();
-            vector3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
-
-            // Avoid placing spheres too close to the big sphere at (4, 0.2, 0)
-            if ((center - vector3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.8) {
-                    // Diffuse sphere
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                } else {
-                    // Metallic sphere
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                }
-
-                scene.add(make_shared<sphere>(center, 0.2, sphere_material));
-            }
+    // Hundreds of small spheres of one size: usually the grid
+    if (choose_accelerator(scene) == accelerator_type::grid) {
+        shared_ptr<uniform_grid> grid;
+        {
+            auto timer = logger.phase("grid_build");
+            grid = make_shared<uniform_grid>(scene);
+            timer.set("primitives", scene.objects.size());
+            timer.set("cells", grid->cell_count());
         }
+        render_sequential_timed(cam, *grid, logger);
+        return;
     }
 
-    // Three large example spheres
-    auto material1 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    scene.add(make_shared<sphere>(vector3(-4, 1, 0), 1.0, material1));
-
-    auto material2 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    scene.add(make_shared<sphere>(vector3(4, 1, 0), 1.0, material2));
-
     // Use a BVH (Bounding Volume Hierarchy) for faster rendering
-    scene = hittable_list(make_shared<bvh_node>(scene));
+    shared_ptr<bvh_node> world;
+    {
+        auto timer = logger.phase("bvh_build");
+        world = make_shared<bvh_node>(scene);
+        timer.set("primitives", scene.objects.size());
+    }
 
-    // Camera setup
-    camera cam;
-    cam.aspect_ratio      = 16.0 / 9.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 20;
-    cam.vfov              = 20;
-    cam.lookfrom          = vector3(13,2,3);
-    cam.lookat            = vector3(0,0,0);
-    cam.vup               = vector3(0,1,0);
-    cam.background        = color(0.7,0.8,1);
-
-    // Render the scene
-    cam.render(scene);
+    // Render the scene through the specialized kernel (spheres only)
+    if (auto specialized = sphere_tri_scene::from_bvh(*world))
+        render_sequential_timed(cam, *specialized, logger);
+    else
+        render_sequential_timed(cam, *world, logger);
+
+#ifdef RAYTRACER_DIAGNOSTICS
+    bvh_statistics(*world).write_json();
+#endif
 }
 
 // --------------------------------------
 // Scene: Three Spheres
-// A simple scene with a ground sphere and three different materials.
 // --------------------------------------
-void three_spheres() {
+void three_spheres(Logger& logger) {
     hittable_list scene;
+    camera cam;
+    three_spheres_scene(scene, cam);
 
-    // Materials
-    auto material_ground = make_shared<lambertian>(color(0.1, 0.2, 0.5));
-    auto material_center = make_shared<lambertian>(color(0.5, 0.1, 0.1));
-    auto material_left   = make_shared<metal>(color(0.8, 0.8, 0.8), 0.1);
-    auto material_right  = make_shared<metal>(color(0.8, 0.6, 0.2), 1.0);
-
-    // Objects
-    scene.add(make_shared<sphere>(vector3( 0.0, -100.5, -1.0), 100.0, material_ground));
-    scene.add(make_shared<sphere>(vector3( 0.0,    0.0, -1.2),   0.5, material_center));
-    scene.add(make_shared<sphere>(vector3(-1.0,    0.0, -1.0),   0.5, material_left));
-    scene.add(make_shared<sphere>(vector3( 1.0,    0.0, -1.0),   0.5, material_right));
+    render_sequential_timed(cam, scene, logger);
+}
 
-    // Camera setup
+// --------------------------------------
+// Scene: Triangles
+// --------------------------------------
+void tris(Logger& logger) {
+    hittable_list scene;
     camera cam;
-    cam.aspect_ratio      = 16.0 / 9.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 10;
-    cam.vfov              = 90;
-    cam.lookfrom          = vector3(0, 0, 0);
-    cam.lookat            = vector3(0, 0, -1);
-    cam.vup               = vector3(0, 1, 0);
-    cam.background        = color(0.7,0.8,1);
-
-    cam.render(scene);
+    tris_scene(scene, cam);
+
+    render_sequential_timed(cam, scene, logger);
 }
 
 // --------------------------------------
-// Scene: Triangles
-// Creates colored triangles forming a cube-like enclosure.
+// Scene: Custom Scene from File
+// Loads objects and camera settings from external txt files.
 // --------------------------------------
-void tris() {
+void custom_scene(Logger& logger) {
+    // Primitives and BVH nodes are allocated from an arena while
+    // loading and building (arena.h), and freed with it at the end
+    scene_arena load_arena;
+    std::optional<arena_scope> scope(load_arena);
+
     hittable_list scene;
+    accelerator_type accelerator = accelerator_type::bvh;
+    {
+        auto timer = logger.phase("scene_parse");
+        scene = load_scene_from_file("custom_scene.txt", &logger, &accelerator);
+        timer.set("primitives", scene.objects.size());
+    }
 
-    // Materials for each wall
-    auto left_red     = make_shared<lambertian>(color(1.0, 0.2, 0.2));
-    auto back_green   = make_shared<lambertian>(color(0.2, 1.0, 0.2));
-    auto right_blue   = make_shared<lambertian>(color(0.2, 0.2, 1.0));
-    auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
-    auto lower_teal   = make_shared<lambertian>(color(0.2, 0.8, 0.8));
+    camera cam;
+    set_camera("camera_settings.txt", cam);
 
-    // Add triangle faces (two per wall)
-    scene.add(make_shared<tri>(vector3(-3,-2, 5), vector3(-3, -2, 1), vector3(-3, 2, 5), left_red));
-    scene.add(make_shared<tri>(vector3(-3,2, 1),  vector3(-3, -2, 1), vector3(-3, 2, 5), left_red));
+    // The scene file asked for a grid (or for the automatic choice)
+    if (accelerator == accelerator_type::automatic) accelerator = choose_accelerator(scene);
+    if (accelerator == accelerator_type::grid) {
+        shared_ptr<uniform_grid> grid;
+        {
+            auto timer = logger.phase("grid_build");
+            grid = make_shared<uniform_grid>(scene);
+            timer.set("primitives", scene.objects.size());
+            timer.set("cells", grid->cell_count());
+        }
+        scope.reset();
+        render_timed(cam, *grid, logger);
+        return;
+    }
 
-    scene.add(make_shared<tri>(vector3(-2,-2, 0), vector3(2, -2, 0),  vector3(-2, 2, 0), back_green));
-    scene.add(make_shared<tri>(vector3(2,2, 0),   vector3(2, -2, 0),  vector3(-2, 2, 0), back_green));
+    shared_ptr<bvh_node> world;
+    {
+        auto timer = logger.phase("bvh_build");
+        world = make_shared<bvh_node>(scene);
+        timer.set("primitives", scene.objects.size());
+    }
 
-    scene.add(make_shared<tri>(vector3(3,-2, 1),  vector3(3,-2, 5),   vector3(3, 2, 1), right_blue));
-    scene.add(make_shared<tri>(vector3(3,2, 5),   vector3(3,-2, 5),   vector3(3, 2, 1), right_blue));
+    // Spheres and triangles only: flatten the BVH for the specialized
+    // render loop; scenes with instances keep the virtual one
+    shared_ptr<sphere_tri_scene> specialized;
+    {
+        auto timer = logger.phase("bvh_flatten");
+        specialized = sphere_tri_scene::from_bvh(*world);
+        timer.set("specialized", specialized ? 1 : 0);
+    }
 
-    scene.add(make_shared<tri>(vector3(-2, 3, 1), vector3(2, 3, 1),   vector3(-2, 3, 5), upper_orange));
-    scene.add(make_shared<tri>(vector3(2, 3, 5),  vector3(2, 3, 1),   vector3(-2, 3, 5), upper_orange));
+    scope.reset();
 
-    scene.add(make_shared<tri>(vector3(-2,-3, 5), vector3(2,-3, 5),   vector3(-2,-3, 1), lower_teal));
-    scene.add(make_shared<tri>(vector3(2,-3, 1),  vector3(2,-3, 5),   vector3(-2,-3, 1), lower_teal));
+    // Parallel rendering for faster output
+    if (specialized) {
+        render_timed(cam, *specialized, logger);
+    } else {
+        // The virtual render path walks the node tree itself: copy it
+        // into a fresh arena in traversal order first. The load arena
+        // is freed once the old tree and the scene list are gone.
+        scene_arena layout_arena;
+        {
+            auto timer = logger.phase("bvh_relayout");
+            world = world->relocate(layout_arena);
+            scene.clear();
+            timer.set("bytes", layout_arena.bytes_used());
+        }
+        render_timed(cam, *world, logger);
+    }
 
-    // Camera setup
-    camera cam;
-    cam.aspect_ratio      = 1.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 50;
-    cam.vfov              = 80;
-    cam.lookfrom          = vector3(0,0,9);
-    cam.lookat            = vector3(0,0,0);
-    cam.vup               = vector3(0,1,0);
-    cam.background        = color(0.7,0.8,1);
-
-    cam.render(scene);
+#ifdef RAYTRACER_DIAGNOSTICS
+    // BVH quality and per-ray traversal counts, next to render.log
+    bvh_statistics(*world).write_json();
+#endif
 }
 
 // --------------------------------------
-// Scene: Custom Scene from File
-// Loads objects and camera settings from external txt files.
+// Resident custom scene
+// Loads and builds the custom scene as custom_scene() does, then
+// passes it to 'use' in whichever form renders fastest: the grid,
+// the specialized flat BVH or the BVH itself. For the long-running
+// modes below, which keep it for many renders.
 // --------------------------------------
-void custom_scene() {
-    hittable_list scene = load_scene_from_file("custom_scene.txt");
-    scene = hittable_list(make_shared<bvh_node>(scene));
+template <typename Use>
+void with_custom_scene(Logger& logger, Use&& use) {
+    scene_arena load_arena;
+    std::optional<arena_scope> scope(load_arena);
+
+    hittable_list scene;
+    accelerator_type accelerator = accelerator_type::bvh;
+    {
+        auto timer = logger.phase("scene_parse");
+        scene = load_scene_from_file("custom_scene.txt", &logger, &accelerator);
+        timer.set("primitives", scene.objects.size());
+    }
 
+    shared_ptr<uniform_grid> grid;
+    shared_ptr<bvh_node> world;
+    shared_ptr<sphere_tri_scene> specialized;
+    if (accelerator == accelerator_type::automatic) accelerator = choose_accelerator(scene);
+    if (accelerator == accelerator_type::grid) {
+        auto timer = logger.phase("grid_build");
+        grid = make_shared<uniform_grid>(scene);
+    } else {
+        auto timer = logger.phase("bvh_build");
+        world = make_shared<bvh_node>(scene);
+        specialized = sphere_tri_scene::from_bvh(*world);
+    }
+    scope.reset();
+
+    if (grid)
+        use(grid);
+    else if (specialized)
+        use(specialized);
+    else
+        use(world);
+}
+
+// --------------------------------------
+// Render daemon
+// Renders the jobs sent on stdin (or to a UNIX socket when
+// 'socket_path' is given) until shutdown; see render_daemon.h
+// --------------------------------------
+void serve_custom_scene(Logger& logger, const std::string& socket_path) {
+    camera defaults;
+    set_camera("camera_settings.txt", defaults);
+
+    with_custom_scene(logger, [&](auto scene) {
+        render_daemon daemon(scene, defaults, logger);
+        if (socket_path.empty())
+            daemon.serve(std::cin, std::cout);
+        else
+            daemon.serve_socket(socket_path);
+    });
+}
+
+#ifndef _WIN32
+// --------------------------------------
+// Distributed rendering, worker side
+// Renders tiles of the custom scene for the coordinator at
+// host:port until it is done; see distributed.h
+// --------------------------------------
+void work_for_coordinator(Logger& logger, const std::string& host, int port) {
+    with_custom_scene(logger, [&](auto scene) {
+        tile_worker(scene, logger).serve(host, port);
+    });
+}
+
+// --------------------------------------
+// Distributed rendering, coordinator side
+// Spreads the image of camera_settings.txt over the workers that
+// connect to 'port' and writes it as PPM to stdout
+// --------------------------------------
+void coordinate_workers(Logger& logger, int port, const tile_settings& settings) {
     camera cam;
     set_camera("camera_settings.txt", cam);
 
-    // Parallel rendering for faster output
-    cam.render_parallel(scene);
+    tile_coordinator coordinator(cam, settings);
+    std::vector<color> framebuffer;
+    {
+        auto timer = logger.phase("distributed_render");
+        framebuffer = coordinator.render(port);
+        timer.set("workers", coordinator.workers);
+        timer.set("lost_workers", coordinator.lost);
+        timer.set("tile_copies", coordinator.copies);
+    }
+    if (framebuffer.empty()) return;
+
+    auto timer = logger.phase("image_write");
+    cam.prepare();
+    cam.write_image(framebuffer, std::cout);
+}
+#endif
+
+// --------------------------------------
+// Scene: Turntable
+// The turntable scene (scenes.h) animated. Every frame moves the
+// instances and refits the top-level BVH instead of rebuilding it,
+// then writes frame_NNN.ppm.
+// --------------------------------------
+void turntable(Logger& logger) {
+    const int frames = 24;
+
+    hittable_list scene;
+    camera cam;
+    std::vector<shared_ptr<instance>> instances;
+    turntable_scene(scene, cam, instances);
+
+    auto build_start = std::chrono::steady_clock::now();
+    shared_ptr<bvh_node> world;
+    {
+        auto timer = logger.phase("bvh_build");
+        world = make_shared<bvh_node>(scene);
+        timer.set("primitives", scene.objects.size());
+    }
+    std::chrono::duration<double, std::milli> build_time =
+        std::chrono::steady_clock::now() - build_start;
+
+    for (int frame = 0; frame < frames; frame++) {
+        turntable_pose(instances, 360.0 * frame / frames);
+
+        auto refit_start = std::chrono::steady_clock::now();
+        {
+            auto timer = logger.phase("bvh_refit");
+            world->refit();
+            timer.set("frame", frame);
+        }
+        std::chrono::duration<double, std::milli> refit_time =
+            std::chrono::steady_clock::now() - refit_start;
+
+        std::clog << "Frame " << frame << ": BVH refit " << refit_time.count()
+                  << " ms (full build " << build_time.count() << " ms)\n";
+
+        std::string index = std::to_string(frame);
+        std::ofstream out("frame_" + std::string(3 - std::min<size_t>(3, index.size()), '0') + index + ".ppm");
+        render_timed(cam, *world, logger, out);
+    }
 }
 
 // --------------------------------------
 // Main entry point
-// Logs start and end, then selects a scene to render.
+// Logs start and end (phases are logged by the scenes),
+// then selects a scene to render. Long-running modes render
+// the custom scene instead:
+//   --daemon [--socket path]   jobs on stdin or a UNIX socket
+//   --coordinator port [--tile-rows n] [--tile-timeout s]
+//                              one image over connected workers
+//   --worker host:port         tiles for a coordinator
 // --------------------------------------
-int main() {
+int main(int argc, char* argv[]) {
     Logger logger;
 
+    std::string mode, socket_path, coordinator_host;
+    int port = 0;
+    tile_settings tiles;
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "--daemon") {
+            mode = "daemon";
+        } else if (arg == "--socket" && a + 1 < argc) {
+            mode = "daemon";
+            socket_path = argv[++a];
+        } else if (arg == "--coordinator" && a + 1 < argc) {
+            mode = "coordinator";
+            port = std::stoi(argv[++a]);
+        } else if (arg == "--worker" && a + 1 < argc) {
+            mode = "worker";
+            std::string address = argv[++a];
+            size_t colon = address.rfind(':');
+            coordinator_host = colon == std::string::npos ? "localhost" : address.substr(0, colon);
+            port = std::stoi(colon == std::string::npos ? address : address.substr(colon + 1));
+        } else if (arg == "--tile-rows" && a + 1 < argc) {
+            tiles.tile_rows = std::max(1, std::stoi(argv[++a]));
+        } else if (arg == "--tile-timeout" && a + 1 < argc) {
+            tiles.tile_timeout = std::stod(argv[++a]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--daemon [--socket path]]"
+                      << " [--coordinator port [--tile-rows n] [--tile-timeout s]] [--worker host:port]\n";
+            return 2;
+        }
+    }
+
+    if (mode == "daemon") {
+        logger.log("Render daemon started.");
+        serve_custom_scene(logger, socket_path);
+        logger.log("Render daemon stopped.");
+        return 0;
+    }
+    if (mode == "coordinator" || mode == "worker") {
+#ifdef _WIN32
+        std::cerr << "Distributed rendering is not available on this platform\n";
+        return 2;
+#else
+        logger.log("Distributed " + mode + " started.");
+        if (mode == "coordinator")
+            coordinate_workers(logger, port, tiles);
+        else
+            work_for_coordinator(logger, coordinator_host, port);
+        logger.log("Distributed " + mode + " finished.");
+        return 0;
+#endif
+    }
+
     logger.log("Rendering started.");
 
     switch (4) {  // Selects which scene to render (hardcoded to 6)
-        case 1:  many_spheres();   break;
-        case 2:  three_spheres();  break;
-        case 3:  tris();           break;
-        case 4:  custom_scene();   break;
+        case 1:  many_spheres(logger);   break;
+        case 2:  three_spheres(logger);  break;
+        case 3:  tris(logger);           break;
+        case 4:  custom_scene(logger);   break;
+        case 5:  turntable(logger);      break;
     }
 
     logger.log("Rendering finished.");
@@ -1,9 +1,54 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
+#include <cstdint>
+
 #include "ray_tracer.h"
 #include "hittable.h"
 
+// ------------------------------------------------------
+// material_type / material_data
+// Compact, non-virtual description of the built-in
+// materials: a type tag plus the parameters of that type.
+// Every material carries one (material::data()), so the
+// wavefront shade stage can sort hits by material type and
+// shade each type in its own loop, and scatter_material()
+// can shade a single hit, without virtual calls.
+// Materials outside this closed set (other subclasses) keep
+// material_type::custom and are shaded through the virtual
+// interface.
+// ------------------------------------------------------
+enum class material_type : uint8_t { lambertian, metal, diffuse_light, custom };
+constexpr int material_type_count = 4;
+
+struct material_data {
+    material_type type = material_type::custom;
+    color albedo;      // Reflectance, or the emitted color of diffuse_light
+    real fuzz = 0;     // metal only
+};
+
+// ------------------------------------------------------
+// Scatter kernels shared by the material classes and the
+// batched shade loops, so both draw the same random numbers
+// ------------------------------------------------------
+
+// Diffuse scatter direction about 'normal'
+inline vector3 lambertian_scatter_direction(const vector3& normal) {
+    vector3 scatter_direction = normal + random_unit_vector();
+
+    // Handle the case where scatter_direction is nearly zero
+    if (scatter_direction.near_zero())
+        scatter_direction = normal;
+    return scatter_direction;
+}
+
+// Mirror direction of 'in' about 'normal', perturbed by 'fuzz';
+// the ray is absorbed unless dot(result, normal) > 0
+inline vector3 metal_scatter_direction(const vector3& in, const vector3& normal, real fuzz) {
+    vector3 reflected = reflect(in, normal);
+    return reflected.normalize() + (fuzz * random_unit_vector());
+}
+
 // ------------------------------------------------------
 // Base Class: material
 // Represents the surface properties of an object.
@@ -51,6 +96,12 @@ public:
     // Default does nothing.
     // ------------------------------------------------------
     virtual void log() const {}
+
+    // Type tag and parameters for batched shading
+    const material_data& data() const { return packed; }
+
+protected:
+    material_data packed;  // Set by the built-in materials' constructors
 };
 
 // ------------------------------------------------------
@@ -60,7 +111,9 @@ public:
 // ------------------------------------------------------
 class lambertian : public material {
 public:
-    lambertian(const color& albedo) : albedo(albedo) {}
+    lambertian(const color& albedo) {
+        packed = { material_type::lambertian, albedo, 0 };
+    }
 
     bool scatter(
         const ray& r_in,
@@ -69,28 +122,19 @@ public:
         ray& scattered
     ) const override {
         // Random scatter direction for diffuse reflection
-        vector3 scatter_direction = rec.normal + random_unit_vector();
-
-        // Handle the case where scatter_direction is nearly zero
-        if (scatter_direction.near_zero())
-            scatter_direction = rec.normal;
-
-        // Create scattered ray
-        scattered = ray(rec.p, scatter_direction);
+        scattered = ray(rec.p, lambertian_scatter_direction(rec.normal));
 
         // Surface color attenuation
-        attenuation = albedo;
+        attenuation = packed.albedo;
 
         return true;
     }
 
     // Debug log for color
     void log() const override {
+        const color& albedo = packed.albedo;
         std::clog << "\n(" << albedo.x() << ", " << albedo.y() << ", " << albedo.z() << ")";
     }
-
-private:
-    color albedo; // Base surface color
 };
 
 // ------------------------------------------------------
@@ -100,8 +144,10 @@ private:
 // ------------------------------------------------------
 class metal : public material {
 public:
-    metal(const color& albedo, double fuzz)
-        : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
+    // fuzz: reflection fuzziness [0 = perfect mirror], capped at 1
+    metal(const color& albedo, real fuzz) {
+        packed = { material_type::metal, albedo, fuzz < 1 ? fuzz : 1 };
+    }
 
     bool scatter(
         const ray& r_in,
@@ -109,17 +155,11 @@ public:
         color& attenuation,
         ray& scattered
     ) const override {
-        // Reflect the incoming ray around the surface normal
-        vector3 reflected = reflect(r_in.direction(), rec.normal);
-        
-        // Normalize and add fuzz for imperfect reflection
-        reflected = reflected.normalize() + (fuzz * random_unit_vector());
-
-        // Create scattered ray
-        scattered = ray(rec.p, reflected);
+        // Reflect the incoming ray around the surface normal, with fuzz
+        scattered = ray(rec.p, metal_scatter_direction(r_in.direction(), rec.normal, packed.fuzz));
 
         // Color attenuation
-        attenuation = albedo;
+        attenuation = packed.albedo;
 
         // Scatter only if reflection is above the surface
         return (dot(scattered.direction(), rec.normal) > 0);
@@ -127,12 +167,9 @@ public:
 
     // Debug log for color
     void log() const override {
+        const color& albedo = packed.albedo;
         std::clog << "\n\n(" << albedo.x() << ", " << albedo.y() << ", " << albedo.z() << ")\n\n";
     }
-
-private:
-    color albedo; // Surface color
-    double fuzz;  // Reflection fuzziness [0 = perfect mirror]
 };
 
 // ------------------------------------------------------
@@ -142,15 +179,44 @@ private:
 // ------------------------------------------------------
 class diffuse_light : public material {
 public:
-    diffuse_light(const color& albedo) : albedo(albedo) {}
+    diffuse_light(const color& albedo) {
+        packed = { material_type::diffuse_light, albedo, 0 };
+    }
 
     // Emit light with the given color
     color emitted() const override {
-        return albedo;
+        return packed.albedo;
     }
-
-private:
-    color albedo; // Emitted light color
 };
 
+// ------------------------------------------------------
+// scatter_material(mat, r_in, rec, emitted, attenuation, scattered)
+// emitted() and scatter() of 'mat' in one call. The built-in
+// types are handled inline from their material_data; other
+// materials go through the virtual functions. Returns
+// whether the ray scatters, like scatter().
+// ------------------------------------------------------
+inline bool scatter_material(const material& mat, const ray& r_in, const hit_record& rec,
+                             color& emitted, color& attenuation, ray& scattered) {
+    const material_data& data = mat.data();
+    switch (data.type) {
+    case material_type::lambertian:
+        emitted = color(0, 0, 0);
+        scattered = ray(rec.p, lambertian_scatter_direction(rec.normal));
+        attenuation = data.albedo;
+        return true;
+    case material_type::metal:
+        emitted = color(0, 0, 0);
+        scattered = ray(rec.p, metal_scatter_direction(r_in.direction(), rec.normal, data.fuzz));
+        attenuation = data.albedo;
+        return dot(scattered.direction(), rec.normal) > 0;
+    case material_type::diffuse_light:
+        emitted = data.albedo;
+        return false;
+    default:
+        emitted = mat.emitted();
+        return mat.scatter(r_in, rec, attenuation, scattered);
+    }
+}
+
 #endif // MATERIAL_H
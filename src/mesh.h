@@ -0,0 +1,293 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "aabb.h"
+#include "morton.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// ============================================================
+// Indexed triangle meshes and their cleanup
+//
+// OBJ exports often repeat vertices (one copy per face, or per
+// UV seam) and contain zero-area or doubled faces. Each of
+// those becomes a triangle the BVH has to bound and rays have
+// to test. clean_mesh() runs between loading and BVH
+// construction:
+//
+//  1. weld: vertices closer than a tolerance become one
+//  2. drop degenerate faces (two corners welded together, or
+//     an area too small to give a normal)
+//  3. drop duplicate faces (same three vertices, either
+//     winding)
+//  4. reorder faces along a Morton curve of their centroids,
+//     then number the vertices in order of first use, so that
+//     neighbors in space are neighbors in memory; vertices no
+//     face uses are dropped
+// ============================================================
+struct indexed_mesh {
+    std::vector<vector3> vertices;
+    std::vector<std::array<uint32_t, 3>> faces;  // Indices into vertices
+
+    aabb bounds() const {
+        aabb box = aabb::empty;
+        for (const auto& v : vertices) box = aabb(box, aabb(v, v));
+        return box;
+    }
+};
+
+// ------------------------------------------------------
+// What clean_mesh() does
+// ------------------------------------------------------
+struct mesh_cleanup_settings {
+    bool enabled = true;
+    double weld_tolerance = 1e-6;  // Fraction of the bounds diagonal; 0 welds exact copies only
+    bool remove_degenerate = true;
+    bool remove_duplicates = true;
+    bool reorder = true;           // Morton order of faces and vertices
+};
+
+// ------------------------------------------------------
+// What clean_mesh() did
+// ------------------------------------------------------
+struct mesh_cleanup_report {
+    size_t vertices_before = 0, vertices_after = 0;
+    size_t faces_before = 0, faces_after = 0;
+    size_t welded_vertices = 0;       // Merged into another vertex
+    size_t degenerate_faces = 0;
+    size_t duplicate_faces = 0;
+
+    size_t removed_faces() const { return faces_before - faces_after; }
+};
+
+namespace mesh_detail {
+
+// Hash of three cell coordinates (or coordinate bit patterns)
+inline uint64_t cell_key(int64_t x, int64_t y, int64_t z) {
+    return mix_bits(uint64_t(x) * 0x9e3779b97f4a7c15ULL
+                  ^ mix_bits(uint64_t(y) + 0x632be59bd9b4e019ULL)
+                  ^ mix_bits(uint64_t(z) * 0x85ebca77c2b2ae63ULL + 1));
+}
+
+// --------------------------------------------------------
+// chain_table: open-addressing hash table from 64-bit keys
+// to chains of item indices. Keys are expected to be hashes
+// already; different keys may stand for the same cell or
+// face, so callers check every item on a chain.
+// --------------------------------------------------------
+class chain_table {
+  public:
+    static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+    explicit chain_table(size_t items) : next(items, none) {
+        size_t capacity = 16;
+        while (capacity < 2 * items) capacity *= 2;
+        slots.assign(capacity, { 0, none });
+        mask = capacity - 1;
+    }
+
+    // First item stored under 'key', or none; walk on with next_item()
+    uint32_t first_item(uint64_t key) const {
+        for (size_t s = key & mask;; s = (s + 1) & mask) {
+            if (slots[s].head == none) return none;
+            if (slots[s].key == key) return slots[s].head;
+        }
+    }
+    uint32_t next_item(uint32_t item) const { return next[item]; }
+
+    // Prepends 'item' to the chain of 'key'
+    void add(uint64_t key, uint32_t item) {
+        size_t s = key & mask;
+        while (slots[s].head != none && slots[s].key != key) s = (s + 1) & mask;
+        next[item] = slots[s].head;
+        slots[s] = { key, item };
+    }
+
+  private:
+    struct slot {
+        uint64_t key;
+        uint32_t head;
+    };
+    std::vector<slot> slots;
+    std::vector<uint32_t> next;
+    size_t mask;
+};
+
+inline int64_t bits_of(real v) {
+    if (v == 0) v = 0;  // -0 and +0 are the same position
+    int64_t bits = 0;
+    std::memcpy(&bits, &v, sizeof(v));
+    return bits;
+}
+
+// --------------------------------------------------------
+// Returns, for every vertex, the index of the vertex it is
+// welded to (itself for the first of a cluster). Vertices
+// are hashed into cells twice the tolerance wide, so a
+// partner within the tolerance lies in the 2x2x2 block of
+// cells nearest to the vertex.
+// --------------------------------------------------------
+inline std::vector<uint32_t> weld(const std::vector<vector3>& vertices, real tolerance) {
+    std::vector<uint32_t> target(vertices.size());
+    chain_table representatives(vertices.size());  // Unwelded vertices by cell
+
+    const bool exact = !(tolerance > 0);
+    const real cell_size = 2 * tolerance;
+    const real tolerance_squared = tolerance * tolerance;
+
+    for (uint32_t i = 0; i < vertices.size(); i++) {
+        const vector3& p = vertices[i];
+        int64_t cell[3], step[3] = { 0, 0, 0 };
+        for (int axis = 0; axis < 3; axis++) {
+            if (exact) {
+                cell[axis] = bits_of(p[axis]);
+            } else {
+                real scaled = p[axis] / cell_size;
+                cell[axis] = int64_t(std::floor(scaled));
+                step[axis] = (scaled - real(cell[axis]) < real(0.5)) ? -1 : 1;
+            }
+        }
+
+        // Own cell first, then the nearest neighbors (none when exact)
+        target[i] = i;
+        for (int corner = 0; corner < 8 && target[i] == i; corner++) {
+            int64_t dx = (corner & 1) ? step[0] : 0;
+            int64_t dy = (corner & 2) ? step[1] : 0;
+            int64_t dz = (corner & 4) ? step[2] : 0;
+            if (corner > 0 && dx == 0 && dy == 0 && dz == 0) break;
+
+            uint64_t key = cell_key(cell[0] + dx, cell[1] + dy, cell[2] + dz);
+            for (uint32_t j = representatives.first_item(key); j != chain_table::none;
+                 j = representatives.next_item(j)) {
+                if ((vertices[j] - p).length_squared() <= tolerance_squared) {
+                    target[i] = j;
+                    break;
+                }
+            }
+        }
+
+        if (target[i] == i)
+            representatives.add(cell_key(cell[0], cell[1], cell[2]), i);
+    }
+    return target;
+}
+
+} // namespace mesh_detail
+
+// ------------------------------------------------------
+// clean_mesh(mesh, settings)
+// Cleans 'mesh' in place (see above) and reports what was
+// removed.
+// ------------------------------------------------------
+inline mesh_cleanup_report clean_mesh(indexed_mesh& mesh, const mesh_cleanup_settings& settings = {}) {
+    mesh_cleanup_report report;
+    report.vertices_before = report.vertices_after = mesh.vertices.size();
+    report.faces_before = report.faces_after = mesh.faces.size();
+    if (!settings.enabled || mesh.faces.empty()) return report;
+
+    // 1. Weld
+    aabb box = mesh.bounds();
+    real diagonal = std::sqrt(box.x.size() * box.x.size() + box.y.size() * box.y.size()
+                            + box.z.size() * box.z.size());
+    std::vector<uint32_t> target = mesh_detail::weld(mesh.vertices, real(settings.weld_tolerance) * diagonal);
+    for (uint32_t i = 0; i < target.size(); i++)
+        if (target[i] != i) report.welded_vertices++;
+
+    // 2 + 3. Remap faces, dropping degenerate and duplicate ones
+    // A face is degenerate if the sine of its corner angle at
+    // vertex 0 is within rounding error of zero
+    const real min_sine = 16 * std::numeric_limits<real>::epsilon();
+    mesh_detail::chain_table kept_faces(settings.remove_duplicates ? mesh.faces.size() : 0);
+    std::vector<std::array<uint32_t, 3>> sorted_faces;  // Kept faces, indices in ascending order
+    if (settings.remove_duplicates) sorted_faces.reserve(mesh.faces.size());
+
+    size_t kept = 0;
+    for (const auto& face : mesh.faces) {
+        std::array<uint32_t, 3> f = { target[face[0]], target[face[1]], target[face[2]] };
+
+        if (settings.remove_degenerate) {
+            vector3 e1 = mesh.vertices[f[1]] - mesh.vertices[f[0]];
+            vector3 e2 = mesh.vertices[f[2]] - mesh.vertices[f[0]];
+            real n2 = cross(e1, e2).length_squared();
+            bool collapsed = f[0] == f[1] || f[1] == f[2] || f[0] == f[2];
+            if (collapsed || !(n2 > min_sine * min_sine * e1.length_squared() * e2.length_squared())) {
+                report.degenerate_faces++;
+                continue;
+            }
+        }
+
+        if (settings.remove_duplicates) {
+            std::array<uint32_t, 3> sorted = f;
+            std::sort(sorted.begin(), sorted.end());
+            uint64_t key = mesh_detail::cell_key(sorted[0], sorted[1], sorted[2]);
+            bool duplicate = false;
+            for (uint32_t k = kept_faces.first_item(key); k != mesh_detail::chain_table::none && !duplicate;
+                 k = kept_faces.next_item(k))
+                duplicate = sorted_faces[k] == sorted;
+            if (duplicate) {
+                report.duplicate_faces++;
+                continue;
+            }
+            kept_faces.add(key, uint32_t(kept));
+            sorted_faces.push_back(sorted);
+        }
+        mesh.faces[kept++] = f;
+    }
+    mesh.faces.resize(kept);
+
+    // 4. Morton order of the face centroids
+    if (settings.reorder && mesh.faces.size() > 1) {
+        const size_t n = mesh.faces.size();
+        std::vector<vector3> centroids(n);
+        aabb centroid_bounds = aabb::empty;
+        for (size_t i = 0; i < n; i++) {
+            const auto& f = mesh.faces[i];
+            centroids[i] = (mesh.vertices[f[0]] + mesh.vertices[f[1]] + mesh.vertices[f[2]]) / 3;
+            centroid_bounds = aabb(centroid_bounds, aabb(centroids[i], centroids[i]));
+        }
+
+        int bits_per_axis = (n > (size_t(1) << 18)) ? 21 : 10;
+        std::vector<morton_key> keys(n);
+        for (size_t i = 0; i < n; i++) {
+            auto normalized = [&](int axis) {
+                const interval& range = centroid_bounds.axis_interval(axis);
+                return range.size() > 0 ? (centroids[i][axis] - range.min) / range.size() : 0.0;
+            };
+            keys[i] = { morton_encode(normalized(0), normalized(1), normalized(2), bits_per_axis),
+                        uint32_t(i) };
+        }
+        radix_sort(keys, 3 * bits_per_axis);
+
+        std::vector<std::array<uint32_t, 3>> ordered(n);
+        for (size_t i = 0; i < n; i++) ordered[i] = mesh.faces[keys[i].index];
+        mesh.faces.swap(ordered);
+    }
+
+    // Number the vertices in order of first use; unused ones go
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> new_index(mesh.vertices.size(), unused);
+    std::vector<vector3> vertices;
+    vertices.reserve(mesh.vertices.size() - report.welded_vertices);
+    for (auto& face : mesh.faces) {
+        for (auto& index : face) {
+            if (new_index[index] == unused) {
+                new_index[index] = uint32_t(vertices.size());
+                vertices.push_back(mesh.vertices[index]);
+            }
+            index = new_index[index];
+        }
+    }
+    mesh.vertices.swap(vertices);
+
+    report.vertices_after = mesh.vertices.size();
+    report.faces_after = mesh.faces.size();
+    return report;
+}
+
+#endif // MESH_H
@@ -0,0 +1,142 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// ============================================================
+// Morton codes and parallel radix sort
+//
+// A Morton code interleaves the bits of quantized x, y and z
+// coordinates, so sorting points by their codes orders them
+// along a Z-shaped space-filling curve: points that are close
+// in the sorted order are also close in space.
+//
+// Used by the linear BVH builder to order primitives and by
+// the wavefront integrator to reorder rays.
+// ============================================================
+
+// ------------------------------------------------------
+// Spreads the low 10 bits of v so there are two zero bits
+// between each of them (for 30-bit codes).
+// ------------------------------------------------------
+inline uint64_t expand_bits_10(uint64_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v <<  8)) & 0x0300f00f;
+    v = (v | (v <<  4)) & 0x030c30c3;
+    v = (v | (v <<  2)) & 0x09249249;
+    return v;
+}
+
+// ------------------------------------------------------
+// Spreads the low 21 bits of v the same way (for 63-bit codes).
+// ------------------------------------------------------
+inline uint64_t expand_bits_21(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x1f00000000ffffULL;
+    v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+    v = (v | (v <<  8)) & 0x100f00f00f00f00fULL;
+    v = (v | (v <<  4)) & 0x10c30c30c30c30c3ULL;
+    v = (v | (v <<  2)) & 0x1249249249249249ULL;
+    return v;
+}
+
+// ------------------------------------------------------
+// morton_encode(x, y, z, bits_per_axis)
+// x, y, z are normalized to [0,1]. bits_per_axis is 10
+// (30-bit code) or 21 (63-bit code).
+// ------------------------------------------------------
+inline uint64_t morton_encode(double x, double y, double z, int bits_per_axis) {
+    double cells = double(uint64_t(1) << bits_per_axis);
+    auto quantize = [cells](double v) {
+        return uint64_t(std::min(std::max(v * cells, 0.0), cells - 1));
+    };
+
+    if (bits_per_axis <= 10)
+        return (expand_bits_10(quantize(x)) << 2)
+             | (expand_bits_10(quantize(y)) << 1)
+             |  expand_bits_10(quantize(z));
+
+    return (expand_bits_21(quantize(x)) << 2)
+         | (expand_bits_21(quantize(y)) << 1)
+         |  expand_bits_21(quantize(z));
+}
+
+// ------------------------------------------------------
+// A sort key and the index of the item it belongs to
+// ------------------------------------------------------
+struct morton_key {
+    uint64_t code;   // Morton code (or any other sort key)
+    uint32_t index;  // Index of the item in its original array
+};
+
+// ------------------------------------------------------
+// radix_sort(keys, key_bits, max_threads)
+// Sorts keys by their low key_bits bits using an LSD radix
+// sort with 8-bit digits. Every pass is split over the
+// hardware threads: each thread builds a histogram of its
+// chunk, the histograms are turned into per-thread output
+// offsets, and each thread scatters its chunk. The sort is
+// stable, so equal codes keep their input order.
+// max_threads limits the threads used (0 = all hardware
+// threads); callers that already run on every core pass 1.
+// ------------------------------------------------------
+inline void radix_sort(std::vector<morton_key>& keys, int key_bits, int max_threads = 0) {
+    const size_t n = keys.size();
+    const int passes = (key_bits + 7) / 8;
+    const size_t min_chunk = 1 << 14; // Below this, threading costs more than it saves
+
+    int thread_count = int(std::max(1u, std::thread::hardware_concurrency()));
+    if (max_threads > 0) thread_count = std::min(thread_count, max_threads);
+    thread_count = int(std::min<size_t>(thread_count, (n + min_chunk - 1) / min_chunk));
+    thread_count = std::max(thread_count, 1);
+
+    std::vector<morton_key> scratch(n);
+    std::vector<size_t> offsets(size_t(thread_count) * 256);
+
+    for (int pass = 0; pass < passes; pass++) {
+        const int shift = pass * 8;
+        const size_t chunk = (n + thread_count - 1) / thread_count;
+
+        // Run f(t, begin, end) for every thread's chunk
+        auto for_each_chunk = [&](auto&& f) {
+            std::vector<std::thread> threads;
+            for (int t = 1; t < thread_count; t++)
+                threads.emplace_back(f, t, std::min(n, t * chunk), std::min(n, (t + 1) * chunk));
+            f(0, size_t(0), std::min(n, chunk));
+            for (auto& thread : threads) thread.join();
+        };
+
+        // 1. Per-thread digit histograms
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for_each_chunk([&](int t, size_t begin, size_t end) {
+            size_t* histogram = &offsets[size_t(t) * 256];
+            for (size_t i = begin; i < end; i++)
+                histogram[(keys[i].code >> shift) & 0xff]++;
+        });
+
+        // 2. Exclusive prefix sum in (digit, thread) order
+        size_t sum = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            for (int t = 0; t < thread_count; t++) {
+                size_t count = offsets[size_t(t) * 256 + digit];
+                offsets[size_t(t) * 256 + digit] = sum;
+                sum += count;
+            }
+        }
+
+        // 3. Scatter into the scratch buffer
+        for_each_chunk([&](int t, size_t begin, size_t end) {
+            size_t* offset = &offsets[size_t(t) * 256];
+            for (size_t i = begin; i < end; i++)
+                scratch[offset[(keys[i].code >> shift) & 0xff]++] = keys[i];
+        });
+
+        keys.swap(scratch);
+    }
+}
+
+#endif // MORTON_H
@@ -0,0 +1,132 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include "hittable.h"
+
+// ============================================================
+// ray_packet: a group of coherent rays traced together
+//
+// Primary rays of neighboring pixels (up to an 8x8 block)
+// start at the same point and point in nearly the same
+// direction, so they visit almost the same BVH nodes. Tracing
+// them as a packet loads each node once for the whole group.
+//
+// Each ray keeps its own closest hit (t_max, hit, records).
+// Traversal works on a list of "active" ray indices, which
+// shrinks as rays drop out of a subtree.
+//
+// For culling, the packet also stores interval bounds over
+// all its rays: the range of origins and of inverse direction
+// components. They are only valid when every ray's direction
+// has the same (non-zero) sign on each axis ('coherent');
+// other packets are traced ray by ray.
+// ============================================================
+struct ray_packet {
+    static constexpr int max_size = 64;  // 8x8 pixels
+
+    int size = 0;
+    ray rays[max_size];
+    real t_max[max_size];             // Closest hit so far (or infinity)
+    bool hit[max_size];               // Whether records[k] holds a hit
+    hit_record records[max_size];
+
+    // Interval bounds over the whole packet
+    real origin_min[3], origin_max[3];
+    real inv_dir_min[3], inv_dir_max[3];
+    bool coherent = false;
+
+    void clear() { size = 0; }
+
+    void add(const ray& r) {
+        rays[size] = r;
+        t_max[size] = infinity;
+        hit[size] = false;
+        size++;
+    }
+
+    // --------------------------------------------------------
+    // Computes the interval bounds once all rays are added
+    // --------------------------------------------------------
+    void finalize() {
+        coherent = size > 0;
+        for (int axis = 0; axis < 3 && coherent; axis++) {
+            origin_min[axis] = origin_max[axis] = rays[0].origin()[axis];
+            inv_dir_min[axis] = infinity;
+            inv_dir_max[axis] = -infinity;
+            real sign = rays[0].direction()[axis];
+
+            for (int k = 0; k < size; k++) {
+                real d = rays[k].direction()[axis];
+                if (d == 0 || (d > 0) != (sign > 0)) {
+                    coherent = false;
+                    break;
+                }
+                real o = rays[k].origin()[axis];
+                origin_min[axis] = std::min(origin_min[axis], o);
+                origin_max[axis] = std::max(origin_max[axis], o);
+                inv_dir_min[axis] = std::min(inv_dir_min[axis], 1 / d);
+                inv_dir_max[axis] = std::max(inv_dir_max[axis], 1 / d);
+            }
+        }
+    }
+
+    // --------------------------------------------------------
+    // may_hit(box, ray_t, active, count)
+    // Interval-arithmetic box test for the whole packet.
+    // Returns false only if no active ray can hit 'box': for
+    // each axis it bounds the slab entry and exit distances of
+    // every ray at once; if the latest possible entry (over
+    // the axes) comes after the earliest possible exit, or
+    // outside the packet's t range, every ray misses.
+    // Requires a coherent packet.
+    // --------------------------------------------------------
+    bool may_hit(const aabb& box, const interval& ray_t, const int* active, int count) const {
+        real far_limit = ray_t.min;
+        for (int n = 0; n < count; n++) far_limit = std::max(far_limit, t_max[active[n]]);
+
+        real entry = ray_t.min, exit = far_limit;
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& slab = box.axis_interval(axis);
+            bool positive = inv_dir_min[axis] > 0;
+            real near_plane = positive ? slab.min : slab.max;
+            real far_plane  = positive ? slab.max : slab.min;
+
+            entry = std::max(entry, product_min(near_plane, axis));
+            exit  = std::min(exit,  product_max(far_plane,  axis) * aabb::exit_scale);
+            if (entry > exit) return false;
+        }
+        return true;
+    }
+
+  private:
+    // Smallest and largest value of (plane - origin) * inv_dir
+    // over the origin and inverse direction intervals
+    real product_min(real plane, int axis) const {
+        real a = plane - origin_max[axis], b = plane - origin_min[axis];
+        return std::min(std::min(a * inv_dir_min[axis], a * inv_dir_max[axis]),
+                        std::min(b * inv_dir_min[axis], b * inv_dir_max[axis]));
+    }
+
+    real product_max(real plane, int axis) const {
+        real a = plane - origin_max[axis], b = plane - origin_min[axis];
+        return std::max(std::max(a * inv_dir_min[axis], a * inv_dir_max[axis]),
+                        std::max(b * inv_dir_min[axis], b * inv_dir_max[axis]));
+    }
+};
+
+// ------------------------------------------------------
+// Default packet traversal: trace every active ray on its
+// own, keeping each ray's closest hit
+// ------------------------------------------------------
+inline void hittable::hit_packet(ray_packet& packet, interval ray_t,
+                                 const int* active, int count) const {
+    for (int n = 0; n < count; n++) {
+        int k = active[n];
+        if (hit(packet.rays[k], interval(ray_t.min, packet.t_max[k]), packet.records[k])) {
+            packet.t_max[k] = packet.records[k].t;
+            packet.hit[k] = true;
+        }
+    }
+}
+
+#endif // PACKET_H
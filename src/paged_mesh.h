@@ -0,0 +1,567 @@
+#ifndef PAGED_MESH_H
+#define PAGED_MESH_H
+
+#include "aabb.h"
+#include "arena.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "mesh.h"
+#include "tri.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ============================================================
+// Out-of-core triangle meshes
+//
+// load_obj_file() turns every face into a resident tri plus
+// BVH nodes, so a mesh can only be rendered if all of it fits
+// in memory. A paged mesh keeps only the top of its BVH
+// resident:
+//
+//  - write_paged_mesh() cuts a mesh into clusters of a few
+//    hundred neighboring faces and writes each one, with a
+//    BVH of its own, to a page-aligned block of a file. The
+//    blocks hold the clusters exactly as they are traversed
+//    (nodes and the precomputed values of tri::intersect()).
+//  - paged_mesh maps that file into memory and builds a
+//    bvh_node over the cluster bounds. Rays traverse the
+//    clusters they reach directly in the mapping, so the
+//    system reads a cluster's pages on first use.
+//  - a cluster_cache tracks which clusters are resident and,
+//    once they pass its budget, releases the pages of the
+//    least recently used ones. Released pages are read back
+//    (from the page cache, or the disk once memory is short)
+//    when a ray needs them again.
+//
+// Resident memory is the budget plus the top tree, however
+// large the file, and rendering slows down with the rate at
+// which clusters have to be paged back in rather than failing
+// once the mesh outgrows memory.
+//
+// The file is a native-endian cache derived from the mesh and
+// tied to the layout of the build that wrote it (precision,
+// SIMD vectors); paged_mesh::open() rejects others.
+// ============================================================
+
+namespace paged_detail {
+
+constexpr char magic[8] = { 'R', 'T', 'P', 'A', 'G', 'E', 'D', '1' };
+constexpr uint64_t block_alignment = 4096;  // Clusters start on their own pages
+constexpr size_t leaf_size = 4;             // Faces per leaf of a cluster BVH
+
+// Node of a cluster BVH. Inner nodes are followed by their left
+// child; 'index' is the right child. Leaves hold 'count' faces
+// starting at 'index'.
+struct node {
+    aabb box;
+    uint32_t index;
+    uint32_t count;           // 0 for inner nodes
+};
+
+// A face with the values tri::intersect() needs (the material
+// is the mesh's)
+struct triangle {
+    vector3 v0, v1, v2;
+    vector3 normal, w;
+    real D;
+};
+
+static_assert(std::is_trivially_copyable_v<node> && std::is_trivially_copyable_v<triangle>,
+              "clusters are traversed in place in the mapped file");
+
+struct file_header {
+    char magic[8];
+    uint32_t node_size;       // sizeof(node) and sizeof(triangle) of the
+    uint32_t triangle_size;   // writer, which fix the layout of the blocks
+    uint32_t real_size;
+    uint32_t cluster_count;
+    uint64_t face_count;
+    uint64_t table_offset;    // Offset of cluster_count cluster_entry records
+};
+
+struct cluster_entry {
+    aabb bounds;
+    uint64_t offset;          // Start of the cluster's block: nodes, then triangles
+    uint64_t triangle_offset; // Start of the triangles, relative to 'offset'
+    uint64_t size;            // Bytes in the block
+    uint32_t node_count;
+    uint32_t face_count;
+};
+
+inline uint64_t align_up(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// --------------------------------------------------------
+// Splits order[start, end) (face indices) at the median
+// centroid along the longest axis, as bvh_node does, until
+// every part has at most cluster_size faces, and appends the
+// part boundaries to 'ends' in depth-first order
+// --------------------------------------------------------
+inline void partition_faces(const std::vector<vector3>& centroids, std::vector<uint32_t>& order,
+                            size_t start, size_t end, size_t cluster_size, std::vector<size_t>& ends) {
+    if (end - start <= cluster_size) {
+        ends.push_back(end);
+        return;
+    }
+
+    aabb box = aabb::empty;
+    for (size_t i = start; i < end; i++) box = aabb(box, aabb(centroids[order[i]], centroids[order[i]]));
+    int axis = box.longest_axis();
+    size_t mid = start + (end - start) / 2;
+    std::nth_element(order.begin() + start, order.begin() + mid, order.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    partition_faces(centroids, order, start, mid, cluster_size, ends);
+    partition_faces(centroids, order, mid, end, cluster_size, ends);
+}
+
+// --------------------------------------------------------
+// Builds the BVH of one cluster over faces[start, end) by
+// median splits, appending nodes in depth-first order and
+// putting 'faces' into leaf order
+// --------------------------------------------------------
+inline void build_cluster_bvh(std::vector<triangle>& faces, size_t start, size_t end,
+                              std::vector<node>& nodes) {
+    aabb box = aabb::empty, centroids = aabb::empty;
+    for (size_t i = start; i < end; i++) {
+        const triangle& f = faces[i];
+        box = aabb(box, aabb(aabb(f.v0, f.v1), aabb(f.v0, f.v2)));
+        vector3 c = f.v0 + f.v1 + f.v2;
+        centroids = aabb(centroids, aabb(c, c));
+    }
+
+    size_t index = nodes.size();
+    nodes.push_back({ box, uint32_t(start), uint32_t(end - start) });
+    if (end - start <= leaf_size) return;
+
+    int axis = centroids.longest_axis();
+    auto centroid = [&](const triangle& f) { return f.v0[axis] + f.v1[axis] + f.v2[axis]; };
+    size_t mid = start + (end - start) / 2;
+    std::nth_element(faces.begin() + start, faces.begin() + mid, faces.begin() + end,
+                     [&](const triangle& a, const triangle& b) { return centroid(a) < centroid(b); });
+
+    build_cluster_bvh(faces, start, mid, nodes);
+    nodes[index].index = uint32_t(nodes.size());
+    nodes[index].count = 0;
+    build_cluster_bvh(faces, mid, end, nodes);
+}
+
+// --------------------------------------------------------
+// Traverses a cluster like static_scene does: left child
+// first, t range narrowed by earlier hits. The root's box is
+// the cluster's, which the caller has tested. Sets
+// everything in 'rec' but the material.
+// --------------------------------------------------------
+inline bool hit_cluster(const node* nodes, const triangle* faces, const ray& r, interval ray_t,
+                        hit_record& rec) {
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    bool hit_anything = false;
+
+    while (top > 0) {
+        uint32_t index = stack[--top];
+        const node& n = nodes[index];
+        interval range(ray_t.min, hit_anything ? rec.t : ray_t.max);
+        if (index != 0) {
+            RT_COUNT(boxes_tested);
+            if (!n.box.hit(r, range))
+                continue;
+        }
+        RT_COUNT(nodes_visited);
+
+        if (n.count > 0) {
+            for (uint32_t i = n.index; i < n.index + n.count; i++) {
+                const triangle& f = faces[i];
+                if (tri::intersect(r, range, f.v0, f.v1, f.v2, f.normal, f.w, f.D, rec)) {
+                    hit_anything = true;
+                    range.max = rec.t;
+                }
+            }
+            continue;
+        }
+        stack[top++] = n.index;
+        stack[top++] = index + 1;
+    }
+    return hit_anything;
+}
+
+// --------------------------------------------------------
+// mapped_file: read-only memory mapping of a whole file
+// --------------------------------------------------------
+class mapped_file {
+  public:
+    explicit mapped_file(const std::string& filename) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER file_size;
+        if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (view) {
+                    bytes = static_cast<const std::byte*>(view);
+                    length = size_t(file_size.QuadPart);
+                }
+                CloseHandle(mapping);  // The view keeps the mapping alive
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (view != MAP_FAILED) {
+                bytes = static_cast<const std::byte*>(view);
+                length = size_t(info.st_size);
+            }
+        }
+        ::close(fd);  // The mapping stays valid
+#endif
+    }
+
+    ~mapped_file() {
+        if (!bytes) return;
+#ifdef _WIN32
+        UnmapViewOfFile(bytes);
+#else
+        munmap(const_cast<std::byte*>(bytes), length);
+#endif
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    bool is_open() const { return bytes != nullptr; }
+    const std::byte* data() const { return bytes; }
+    size_t size() const { return length; }
+
+    // Drops the pages of [offset, offset + size) from this
+    // process's resident memory; the data stays in the file and
+    // is read back on the next access
+    void release(size_t offset, size_t size) const {
+#ifdef _WIN32
+        // Unlocking pages that are not locked removes them from the working set
+        VirtualUnlock(const_cast<std::byte*>(bytes) + offset, size);
+#else
+        size_t page = size_t(sysconf(_SC_PAGESIZE));
+        size_t begin = offset / page * page;
+        madvise(const_cast<std::byte*>(bytes) + begin, offset + size - begin, MADV_DONTNEED);
+#endif
+    }
+
+  private:
+    const std::byte* bytes = nullptr;
+    size_t length = 0;
+};
+
+} // namespace paged_detail
+
+// --------------------------------------------------------
+// write_paged_mesh(mesh, filename, cluster_size)
+// Writes 'mesh' as a paged mesh file with up to cluster_size
+// faces per cluster. Clusters are stored in the depth-first
+// order of the splits that made them, so neighbors in space
+// are neighbors in the file. Returns false if the file cannot
+// be written.
+// --------------------------------------------------------
+inline bool write_paged_mesh(const indexed_mesh& mesh, const std::string& filename,
+                             size_t cluster_size = 256) {
+    using namespace paged_detail;
+    cluster_size = std::max<size_t>(cluster_size, 1);
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to write paged mesh: " << filename << "\n";
+        return false;
+    }
+
+    // Cluster boundaries in a spatial order of the faces
+    std::vector<uint32_t> order(mesh.faces.size());
+    std::vector<size_t> ends;
+    {
+        std::vector<vector3> centroids(mesh.faces.size());
+        for (size_t f = 0; f < mesh.faces.size(); f++) {
+            const auto& face = mesh.faces[f];
+            centroids[f] = mesh.vertices[face[0]] + mesh.vertices[face[1]] + mesh.vertices[face[2]];
+            order[f] = uint32_t(f);
+        }
+        if (!order.empty()) partition_faces(centroids, order, 0, order.size(), cluster_size, ends);
+    }
+
+    file_header header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.node_size = sizeof(node);
+    header.triangle_size = sizeof(triangle);
+    header.real_size = sizeof(real);
+    header.cluster_count = uint32_t(ends.size());
+    header.face_count = mesh.faces.size();
+    header.table_offset = sizeof(file_header);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // The table is written last; the first block follows its space
+    std::vector<cluster_entry> table(ends.size());
+    uint64_t offset = align_up(header.table_offset + table.size() * sizeof(cluster_entry), block_alignment);
+
+    std::vector<triangle> faces;
+    std::vector<node> nodes;
+    for (size_t c = 0; c < ends.size(); c++) {
+        size_t first = c > 0 ? ends[c - 1] : 0;
+
+        faces.clear();
+        for (size_t i = first; i < ends[c]; i++) {
+            const auto& face = mesh.faces[order[i]];
+            triangle f;
+            f.v0 = mesh.vertices[face[0]];
+            f.v1 = mesh.vertices[face[1]];
+            f.v2 = mesh.vertices[face[2]];
+            tri::precompute(f.v0, f.v1, f.v2, f.normal, f.w, f.D);
+            faces.push_back(f);
+        }
+        nodes.clear();
+        build_cluster_bvh(faces, 0, faces.size(), nodes);
+
+        cluster_entry& entry = table[c];
+        entry.bounds = nodes[0].box;
+        entry.offset = offset;
+        entry.triangle_offset = align_up(nodes.size() * sizeof(node), alignof(triangle));
+        entry.size = entry.triangle_offset + faces.size() * sizeof(triangle);
+        entry.node_count = uint32_t(nodes.size());
+        entry.face_count = uint32_t(faces.size());
+
+        file.seekp(std::streamoff(offset));
+        file.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(node));
+        file.seekp(std::streamoff(offset + entry.triangle_offset));
+        file.write(reinterpret_cast<const char*>(faces.data()), faces.size() * sizeof(triangle));
+        offset = align_up(offset + entry.size, block_alignment);
+    }
+
+    file.seekp(std::streamoff(header.table_offset));
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(cluster_entry));
+    return bool(file);
+}
+
+// ------------------------------------------------------
+// Cache statistics of a paged_mesh
+// ------------------------------------------------------
+struct cluster_cache_stats {
+    uint64_t misses = 0;          // Clusters paged in (first use or after eviction)
+    uint64_t evictions = 0;
+    uint64_t bytes_paged_in = 0;
+    size_t resident_bytes = 0;    // Clusters currently counted as resident
+};
+
+// ------------------------------------------------------
+// Class: cluster_cache
+// Tracks which clusters of a mapped file are resident and
+// releases the pages of the least recently used ones when
+// their total size passes the budget. Recency is tracked with
+// the clock approximation of LRU: a use only sets the
+// cluster's referenced flag, without a lock, and eviction
+// sweeps the clusters in a circle, passing over (and
+// clearing) referenced ones once.
+//
+// Releasing a cluster that another thread is still reading
+// is harmless: its pages are simply read back from the file.
+// ------------------------------------------------------
+class cluster_cache {
+  public:
+    cluster_cache(const paged_detail::mapped_file& file,
+                  const std::vector<paged_detail::cluster_entry>& table, size_t budget_bytes)
+        : file(file), table(table), slots(new slot[table.size()]), budget(budget_bytes) {}
+
+    // Marks cluster 'id' as used, paging it in (and others out) if needed
+    void touch(uint32_t id) {
+        slot& s = slots[id];
+        if (s.resident.load(std::memory_order_relaxed)) {
+            // Skip the store when set, so threads sharing a cluster do not contend
+            if (!s.referenced.load(std::memory_order_relaxed))
+                s.referenced.store(true, std::memory_order_relaxed);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (s.resident.load(std::memory_order_relaxed)) return;  // Another thread was first
+        s.referenced.store(true, std::memory_order_relaxed);
+        s.resident.store(true, std::memory_order_relaxed);
+        resident_count++;
+        stats.resident_bytes += table[id].size;
+        stats.bytes_paged_in += table[id].size;
+        stats.misses++;
+
+        while (stats.resident_bytes > budget && resident_count > 1) {
+            uint32_t victim = hand;
+            hand = (hand + 1) % uint32_t(table.size());
+            slot& v = slots[victim];
+            if (victim == id || !v.resident.load(std::memory_order_relaxed)) continue;
+            if (v.referenced.load(std::memory_order_relaxed)) {
+                v.referenced.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            v.resident.store(false, std::memory_order_relaxed);
+            resident_count--;
+            stats.resident_bytes -= table[victim].size;
+            stats.evictions++;
+            file.release(size_t(table[victim].offset), size_t(table[victim].size));
+        }
+    }
+
+    cluster_cache_stats statistics() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+  private:
+    struct slot {
+        std::atomic<bool> resident{false};
+        std::atomic<bool> referenced{false};
+    };
+
+    const paged_detail::mapped_file& file;
+    const std::vector<paged_detail::cluster_entry>& table;
+    std::unique_ptr<slot[]> slots;
+    size_t budget;
+    size_t resident_count = 0;
+    uint32_t hand = 0;  // Next eviction candidate
+    cluster_cache_stats stats;
+    mutable std::mutex mutex;
+};
+
+// ------------------------------------------------------
+// Class: paged_mesh
+// A mesh rendered from a paged mesh file (see above). Only
+// the cluster table and the BVH over the clusters are held
+// in memory; cache_bytes bounds the resident clusters.
+// ------------------------------------------------------
+class paged_mesh : public hittable {
+  public:
+    // --------------------------------------------------------
+    // open(filename, mat, cache_bytes)
+    // Maps a file written by write_paged_mesh(). Returns
+    // nullptr if it cannot be read or was written by a build
+    // with another layout.
+    // --------------------------------------------------------
+    static shared_ptr<paged_mesh> open(const std::string& filename, shared_ptr<material> mat,
+                                       size_t cache_bytes) {
+        using namespace paged_detail;
+        auto mesh = shared_ptr<paged_mesh>(new paged_mesh(filename, mat));
+        const mapped_file& file = mesh->file;
+
+        file_header header;
+        if (!file.is_open() || file.size() < sizeof(header)) return nullptr;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.node_size != sizeof(node)
+            || header.triangle_size != sizeof(triangle) || header.real_size != sizeof(real)
+            || header.table_offset + uint64_t(header.cluster_count) * sizeof(cluster_entry) > file.size())
+            return nullptr;
+
+        mesh->table.resize(header.cluster_count);
+        std::memcpy(static_cast<void*>(mesh->table.data()), file.data() + header.table_offset,
+                    mesh->table.size() * sizeof(cluster_entry));
+        file.release(0, size_t(header.table_offset + mesh->table.size() * sizeof(cluster_entry)));
+        for (const auto& entry : mesh->table)
+            if (entry.offset % block_alignment != 0 || entry.offset + entry.size > file.size())
+                return nullptr;
+
+        mesh->triangles = header.face_count;
+        mesh->cache = std::make_unique<cluster_cache>(file, mesh->table, cache_bytes);
+        if (mesh->table.empty()) return mesh;
+
+        // The top tree lives in an arena of the mesh's own, not
+        // in whichever arena the scene is being loaded into
+        arena_scope scope(mesh->tree_arena);
+        hittable_list proxies;
+        for (uint32_t id = 0; id < mesh->table.size(); id++)
+            proxies.add(make_scene_object<cluster_proxy>(mesh.get(), id));
+        mesh->tree = make_scene_object<bvh_node>(proxies);
+        mesh->bbox = mesh->tree->bounding_box();
+        return mesh;
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return tree && tree->hit(r, ray_t, rec);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    size_t cluster_count() const { return table.size(); }
+    size_t triangle_count() const { return triangles; }
+    size_t file_bytes() const { return file.size(); }
+    cluster_cache_stats cache_statistics() const { return cache->statistics(); }
+
+  private:
+    // --------------------------------------------------------
+    // Leaf of the top tree: one cluster, traversed in the
+    // mapping once its box is hit
+    // --------------------------------------------------------
+    class cluster_proxy : public hittable {
+      public:
+        cluster_proxy(const paged_mesh* mesh, uint32_t id) : mesh(mesh), id(id) {
+            const paged_detail::cluster_entry& entry = mesh->table[id];
+            const std::byte* block = mesh->file.data() + entry.offset;
+            nodes = reinterpret_cast<const paged_detail::node*>(block);
+            faces = reinterpret_cast<const paged_detail::triangle*>(block + entry.triangle_offset);
+            bbox = entry.bounds;
+        }
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            // Only clusters a ray actually enters are paged in
+            RT_COUNT(boxes_tested);
+            if (!bbox.hit(r, ray_t)) return false;
+            mesh->cache->touch(id);
+            if (!paged_detail::hit_cluster(nodes, faces, r, ray_t, rec)) return false;
+            rec.mat = mesh->mat;
+            return true;
+        }
+
+        aabb bounding_box() const override { return bbox; }
+
+      private:
+        const paged_mesh* mesh;
+        uint32_t id;
+        const paged_detail::node* nodes;
+        const paged_detail::triangle* faces;
+        aabb bbox;
+    };
+
+    paged_detail::mapped_file file;
+    shared_ptr<material> mat;
+    std::vector<paged_detail::cluster_entry> table;
+    size_t triangles = 0;
+    std::unique_ptr<cluster_cache> cache;
+    scene_arena tree_arena;
+    shared_ptr<bvh_node> tree;
+    aabb bbox;
+
+    paged_mesh(const std::string& filename, shared_ptr<material> mat) : file(filename), mat(mat) {}
+};
+
+#endif // PAGED_MESH_H
@@ -2,34 +2,38 @@
 #define RAY_H
 
 // --------------------------------------
-// Class: ray
+// Class: basic_ray<T>
 // Represents a mathematical ray in 3D space,
 // defined by an origin point and a direction vector.
+// The renderer uses ray = basic_ray<real>.
 // --------------------------------------
-class ray {
+template <typename T>
+class basic_ray {
 public:
     // Default constructor (creates an uninitialized ray)
-    ray() {}
+    basic_ray() {}
 
     // Constructor: creates a ray with a given origin and direction
-    ray(const vector3& origin, const vector3& direction)
+    basic_ray(const basic_vector3<T>& origin, const basic_vector3<T>& direction)
         : orig(origin), dir(direction) {}
 
     // Returns the ray's origin point
-    const vector3& origin() const { return orig; }
+    const basic_vector3<T>& origin() const { return orig; }
 
     // Returns the ray's direction vector
-    const vector3& direction() const { return dir; }
+    const basic_vector3<T>& direction() const { return dir; }
 
     // Returns the point along the ray at parameter t:
     // P(t) = origin + t * direction
-    vector3 at(double t) const {
+    basic_vector3<T> at(T t) const {
         return orig + t * dir;
     }
 
 private:
-    vector3 orig; // The starting point of the ray
-    vector3 dir;  // The direction vector of the ray
+    basic_vector3<T> orig; // The starting point of the ray
+    basic_vector3<T> dir;  // The direction vector of the ray
 };
 
+using ray = basic_ray<real>;
+
 #endif // RAY_H
\ No newline at end of file
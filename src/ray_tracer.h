@@ -2,6 +2,7 @@
 #define RAY_TRACER_H
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <limits>
@@ -10,6 +11,19 @@
 using std::shared_ptr;
 using std::make_shared;
 
+// ------------------------------------------------------
+// Scalar type of the geometry core: vectors, rays,
+// intervals, bounding boxes, hit records and the
+// framebuffer. Double by default; configure with
+// -DRAYTRACER_FLOAT=ON for single precision (half the
+// memory for vertices, bounds and pixels).
+// ------------------------------------------------------
+#ifdef RAYTRACER_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
+
 // Common constants for ray tracing
 const double infinity = std::numeric_limits<double>::infinity();
 const double pi = 3.1415926535897932385;
@@ -19,9 +33,35 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
+// ------------------------------------------------------
+// Random numbers
+// Every thread has its own generator state (SplitMix64), so
+// threads never share or lock a generator, and a render is
+// reproducible: the camera reseeds the generator from
+// (seed, pixel, sample) before tracing each sample.
+// ------------------------------------------------------
+inline uint64_t& random_state() {
+    thread_local uint64_t state = 0x853c49e6748fea9bULL;
+    return state;
+}
+
+// Mixes a 64-bit value into a well-distributed hash (SplitMix64 finalizer)
+inline uint64_t mix_bits(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Sets the calling thread's generator state
+inline void seed_random(uint64_t seed) {
+    random_state() = mix_bits(seed);
+}
+
 // Returns a random real in [0,1)
 inline double random_double() {
-    return std::rand() / (RAND_MAX + 1.0);
+    uint64_t& state = random_state();
+    state += 0x9e3779b97f4a7c15ULL;
+    return double(mix_bits(state) >> 11) * (1.0 / 9007199254740992.0);
 }
 
 // Returns a random real in [min,max)
@@ -0,0 +1,239 @@
+#ifndef RENDER_DAEMON_H
+#define RENDER_DAEMON_H
+
+#include "camera.h"
+#include "input.h"
+#include "log.h"
+#include "socket_stream.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/un.h>
+#endif
+
+// ============================================================
+// render_daemon: renders many images of one resident scene
+//
+// A normal run loads the scene, builds its accelerator, renders
+// one image and exits. A camera sweep repeats the load and the
+// build for every frame. The daemon keeps the built scene and
+// renders jobs as they arrive, on the shared thread_pool.
+//
+// Jobs are plain text, one setting per line, in the format of
+// camera_settings.txt, closed by a "render" line:
+//
+//   image_size 320 180          # or image_width / aspect_ratio
+//   samples_per_pixel 16
+//   lookfrom 13 2 3
+//   output sweep_001.ppm        # required
+//   render
+//
+// Every job starts from the daemon's default camera (its
+// camera_settings.txt); settings do not carry over to the next
+// job. Each job is answered with one line:
+//
+//   ok sweep_001.ppm 412.7 ms
+//   error <reason>
+//
+// "shutdown" stops the daemon once running jobs are done. Lines
+// starting with '#' are ignored.
+//
+// Jobs come from a stream (serve(), e.g. stdin with replies on
+// stdout) or from clients of a UNIX domain socket
+// (serve_socket(); not available on Windows). Every socket
+// connection is served on its own thread, so jobs of several
+// clients render at the same time and share the pool's workers.
+// ============================================================
+class render_daemon {
+  public:
+    // --------------------------------------------------------
+    // Serves 'scene' (any hittable or static_scene), keeping it
+    // alive, with 'defaults' as the starting point of each job
+    // --------------------------------------------------------
+    template <typename Scene>
+    render_daemon(shared_ptr<Scene> scene, const camera& defaults, Logger& logger,
+                  thread_pool& pool = shared_thread_pool())
+        : defaults(defaults), logger(logger),
+          render([scene, &pool](camera& cam) { return cam.render_framebuffer(*scene, pool); }) {}
+
+    // --------------------------------------------------------
+    // serve(in, out)
+    // Runs the jobs read from 'in' and answers each on 'out',
+    // until the stream ends or a "shutdown" line arrives
+    // --------------------------------------------------------
+    void serve(std::istream& in, std::ostream& out) {
+        camera cam = defaults;
+        std::string output;
+        std::string error;  // Reply for a job with an invalid setting
+        std::string line;
+
+        while (!stopping && std::getline(in, line)) {
+            std::istringstream iss(line);
+            std::string key;
+            if (!(iss >> key) || key[0] == '#') continue;
+
+            if (key == "render") {
+                out << (error.empty() ? run_job(cam, output) : error) << std::endl;
+                cam = defaults;
+                output.clear();
+                error.clear();
+            } else if (key == "output") {
+                iss >> output;
+            } else if (key == "image_size") {
+                int width = 0, height = 0;
+                iss >> width >> height;
+                if (!set_image_size(cam, width, height)) error = "error invalid image size";
+            } else if (key == "shutdown") {
+                stopping = true;
+            } else if (!read_camera_setting(iss, key, cam)) {
+                out << "error unknown setting: " << key << std::endl;
+            }
+        }
+    }
+
+    // --------------------------------------------------------
+    // serve_socket(path)
+    // Listens on the UNIX domain socket 'path' and serves every
+    // client connection (see above) until a client sends
+    // "shutdown". Returns false if the socket cannot be opened.
+    // --------------------------------------------------------
+    bool serve_socket(const std::string& path) {
+#ifdef _WIN32
+        std::cerr << "Render daemon: UNIX sockets are not available on this platform\n";
+        (void)path;
+        return false;
+#else
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Render daemon: socket path too long: " << path << "\n";
+            return false;
+        }
+        path.copy(address.sun_path, path.size());
+
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        ::unlink(path.c_str());  // Left behind by an earlier daemon
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+                         || listen(listener, 16) != 0) {
+            std::cerr << "Render daemon: cannot listen on " << path << "\n";
+            if (listener >= 0) ::close(listener);
+            return false;
+        }
+        logger.log("Render daemon listening on " + path);
+
+        std::vector<std::thread> clients;
+        while (!stopping) {
+            int client = accept(listener, nullptr, nullptr);
+            if (client < 0) break;  // Listener shut down
+            join_finished(clients);
+            {
+                std::lock_guard<std::mutex> lock(clients_mutex);
+                connected.push_back(client);
+            }
+            clients.emplace_back([this, client] {
+                {
+                    socket_buffer buffer(client);
+                    std::iostream stream(&buffer);
+                    serve(stream, stream);
+                }
+                std::lock_guard<std::mutex> lock(clients_mutex);
+                connected.erase(std::find(connected.begin(), connected.end(), client));
+                finished.push_back(std::this_thread::get_id());
+                ::close(client);
+                if (stopping) stop_listening();
+            });
+        }
+        for (auto& client : clients) client.join();
+
+        ::close(listener);
+        ::unlink(path.c_str());
+        return true;
+#endif
+    }
+
+  private:
+    camera defaults;
+    Logger& logger;
+    std::function<std::vector<color>(camera&)> render;
+    std::atomic<bool> stopping{false};
+    int listener = -1;
+    std::mutex clients_mutex;
+    std::vector<int> connected;  // Open client sockets
+    std::vector<std::thread::id> finished;  // Client threads done, not yet joined
+
+#ifndef _WIN32
+    // Joins the client threads that have ended since the last
+    // call, so a long-running daemon keeps only the live ones
+    void join_finished(std::vector<std::thread>& clients) {
+        std::vector<std::thread::id> ended;
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            ended.swap(finished);
+        }
+        for (std::thread::id id : ended) {
+            auto thread = std::find_if(clients.begin(), clients.end(),
+                                       [id](const std::thread& t) { return t.get_id() == id; });
+            thread->join();
+            clients.erase(thread);
+        }
+    }
+
+    // Wakes accept() and ends every connection once its running
+    // job is done (called with clients_mutex held)
+    void stop_listening() {
+        ::shutdown(listener, SHUT_RDWR);
+        for (int client : connected) ::shutdown(client, SHUT_RD);
+    }
+#endif
+
+    // Width and height in pixels; the camera derives the height
+    // from the aspect ratio, rounding down. False for a size
+    // below 1x1.
+    static bool set_image_size(camera& cam, int width, int height) {
+        if (width < 1 || height < 1) return false;
+        cam.image_width = width;
+        cam.aspect_ratio = double(width) / height;
+        while (int(width / cam.aspect_ratio) < height)
+            cam.aspect_ratio = std::nextafter(cam.aspect_ratio, 0.0);
+        return true;
+    }
+
+    // Renders one job and returns its reply line
+    std::string run_job(camera& cam, const std::string& output) {
+        if (output.empty()) return "error no output path";
+        if (cam.image_width < 1 || cam.samples_per_pixel < 1 || !(cam.aspect_ratio > 0))
+            return "error invalid image size or sample count";
+
+        std::ofstream file(output);
+        if (!file) return "error cannot write " + output;
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            auto timer = logger.phase("daemon_job");
+            auto framebuffer = render(cam);
+            cam.write_image(framebuffer, file);
+            timer.set("pixels", framebuffer.size());
+            timer.set("samples_per_pixel", cam.samples_per_pixel);
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::ostringstream reply;
+        reply << "ok " << output << ' ' << elapsed.count() << " ms";
+        return reply.str();
+    }
+};
+
+#endif // RENDER_DAEMON_H
@@ -0,0 +1,378 @@
+#ifndef SBVH_H
+#define SBVH_H
+
+#include "bvh.h"
+
+#include <array>
+#include <vector>
+
+// ============================================================
+// Spatial-split BVH (SBVH) builder
+//
+// Object-partition BVHs put every primitive in exactly one
+// subtree. Long, thin triangles then force large, overlapping
+// node boxes that no split can separate. The SBVH builder
+// (Stich et al. 2009) may also split *space*: a primitive that
+// straddles a split plane is referenced from both sides, and
+// each reference only covers the part of the primitive that was
+// clipped to its side (see hittable::clipped_box).
+//
+// Every node picks the cheaper of a binned SAH object split and
+// a binned spatial split. Spatial splits are only tried when the
+// children of the object split overlap noticeably, and they stop
+// once the number of references reaches the duplication budget.
+//
+// The result is an ordinary bvh_node tree whose node boxes are
+// tighter than the primitives they contain.
+// ============================================================
+
+struct sbvh_settings {
+    bool   spatial_splits   = true;  // false = binned SAH object splits only
+    double max_duplication  = 0.5;   // Extra references allowed, as a fraction of the primitive count
+    double min_overlap      = 1e-5;  // Child overlap (relative to the root area) that enables spatial splits
+    static constexpr int bins = 16;  // Bins per axis for both split searches
+};
+
+class sbvh_builder {
+  public:
+    sbvh_builder(const sbvh_settings& settings = sbvh_settings()) : settings(settings) {}
+
+    // --------------------------------------------------------
+    // build(list)
+    // Builds the tree over all objects in the list.
+    // --------------------------------------------------------
+    shared_ptr<bvh_node> build(const hittable_list& list) {
+        std::vector<reference> refs;
+        refs.reserve(list.objects.size());
+        for (const auto& object : list.objects)
+            refs.push_back({object, object->bounding_box()});
+
+        primitive_count = refs.size();
+        reference_limit = size_t(double(primitive_count) * (1.0 + settings.max_duplication));
+        reference_count = refs.size();
+        root_area = list.bounding_box().surface_area();
+
+        auto root = build_range(refs);
+        if (auto node = std::dynamic_pointer_cast<bvh_node>(root))
+            return node;
+        return make_scene_object<bvh_node>(root, root); // Single-object scene
+    }
+
+    // Number of primitive references in the last built tree
+    size_t references() const { return reference_count; }
+
+    // Number of primitives in the last built tree
+    size_t primitives() const { return primitive_count; }
+
+  private:
+    // A primitive together with the part of it this reference covers
+    struct reference {
+        shared_ptr<hittable> object;
+        aabb box;
+    };
+
+    // Result of a split search
+    struct split_candidate {
+        double cost = infinity;
+        int axis = -1;
+        double plane = 0;      // Split position (spatial splits)
+        int bin = 0;           // First bin on the right side (object splits)
+    };
+
+    sbvh_settings settings;
+    size_t primitive_count = 0;
+    size_t reference_limit = 0;
+    size_t reference_count = 0;
+    double root_area = 0;
+
+    // Padded copy of a box, so flat boxes still hit (see aabb::pad_to_minimums)
+    static aabb padded(const aabb& box) { return aabb(box.x, box.y, box.z); }
+
+    static vector3 centroid(const aabb& box) {
+        return 0.5 * vector3(box.x.min + box.x.max, box.y.min + box.y.max, box.z.min + box.z.max);
+    }
+
+    // --------------------------------------------------------
+    // Recursively builds the subtree for a set of references.
+    // --------------------------------------------------------
+    shared_ptr<hittable> build_range(std::vector<reference>& refs) {
+        aabb bounds = aabb::empty;
+        for (const auto& ref : refs)
+            bounds = aabb(bounds, ref.box);
+
+        if (refs.size() == 1)
+            return refs[0].object;
+        if (refs.size() == 2) {
+            if (refs[0].object == refs[1].object) // Two parts of one primitive
+                return refs[0].object;
+            return make_scene_object<bvh_node>(refs[0].object, refs[1].object, padded(bounds));
+        }
+
+        std::vector<reference> left, right;
+        partition(refs, bounds, left, right);
+        refs.clear();
+        refs.shrink_to_fit();
+
+        auto left_child  = build_range(left);
+        auto right_child = build_range(right);
+        return make_scene_object<bvh_node>(left_child, right_child, padded(bounds));
+    }
+
+    // --------------------------------------------------------
+    // Splits refs into left and right using the cheaper of the
+    // object and spatial split. Falls back to a median split if
+    // neither separates the references.
+    // --------------------------------------------------------
+    void partition(const std::vector<reference>& refs, const aabb& bounds,
+                   std::vector<reference>& left, std::vector<reference>& right) {
+        aabb centroid_bounds = aabb::empty;
+        for (const auto& ref : refs) {
+            vector3 c = centroid(ref.box);
+            centroid_bounds = aabb(centroid_bounds, aabb(c, c));
+        }
+
+        aabb left_box, right_box;
+        split_candidate object = find_object_split(refs, centroid_bounds, left_box, right_box);
+
+        split_candidate spatial;
+        if (settings.spatial_splits && reference_count < reference_limit) {
+            double overlap = left_box.intersect(right_box).is_empty()
+                           ? 0 : left_box.intersect(right_box).surface_area();
+            if (overlap / root_area > settings.min_overlap)
+                spatial = find_spatial_split(refs, bounds);
+        }
+
+        if (spatial.cost < object.cost) {
+            split_spatially(refs, bounds, spatial, left, right);
+            if (!left.empty() && !right.empty())
+                return;
+            left.clear();
+            right.clear();
+        }
+
+        if (object.axis >= 0) {
+            const interval& range = centroid_bounds.axis_interval(object.axis);
+            for (const auto& ref : refs) {
+                (bin_of(centroid(ref.box)[object.axis], range) < object.bin ? left : right).push_back(ref);
+            }
+            if (!left.empty() && !right.empty())
+                return;
+            left.clear();
+            right.clear();
+        }
+
+        // Fallback: median split along the longest centroid axis
+        int axis = centroid_bounds.longest_axis();
+        std::vector<reference> sorted = refs;
+        std::sort(sorted.begin(), sorted.end(), [axis](const reference& a, const reference& b) {
+            return centroid(a.box)[axis] < centroid(b.box)[axis];
+        });
+        auto mid = sorted.begin() + sorted.size() / 2;
+        left.assign(sorted.begin(), mid);
+        right.assign(mid, sorted.end());
+    }
+
+    static int bin_of(double value, const interval& range) {
+        int bin = int(sbvh_settings::bins * (value - range.min) / range.size());
+        return std::min(std::max(bin, 0), sbvh_settings::bins - 1);
+    }
+
+    // --------------------------------------------------------
+    // Binned SAH object split. Each reference goes to the bin
+    // of its centroid; the cost of every bin boundary is
+    //   SA(left) * N(left) + SA(right) * N(right).
+    // Also returns the child boxes of the best split so the
+    // caller can measure their overlap.
+    // --------------------------------------------------------
+    split_candidate find_object_split(const std::vector<reference>& refs, const aabb& centroid_bounds,
+                                      aabb& best_left, aabb& best_right) const {
+        const int bins = sbvh_settings::bins;
+        split_candidate best;
+
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& range = centroid_bounds.axis_interval(axis);
+            std::array<aabb, bins> boxes;
+            std::array<size_t, bins> counts{};
+            boxes.fill(aabb::empty);
+
+            for (const auto& ref : refs) {
+                int b = bin_of(centroid(ref.box)[axis], range);
+                boxes[b] = aabb(boxes[b], ref.box);
+                counts[b]++;
+            }
+
+            // Sweep from the right to get suffix boxes/counts
+            std::array<aabb, bins> right_boxes;
+            std::array<size_t, bins> right_counts{};
+            aabb acc = aabb::empty;
+            size_t n = 0;
+            for (int b = bins - 1; b > 0; b--) {
+                acc = aabb(acc, boxes[b]);
+                n += counts[b];
+                right_boxes[b] = acc;
+                right_counts[b] = n;
+            }
+
+            acc = aabb::empty;
+            n = 0;
+            for (int b = 1; b < bins; b++) {
+                acc = aabb(acc, boxes[b - 1]);
+                n += counts[b - 1];
+                if (n == 0 || right_counts[b] == 0) continue;
+
+                double cost = acc.surface_area() * double(n)
+                            + right_boxes[b].surface_area() * double(right_counts[b]);
+                if (cost < best.cost) {
+                    best.cost = cost;
+                    best.axis = axis;
+                    best.bin = b;
+                    best_left = acc;
+                    best_right = right_boxes[b];
+                }
+            }
+        }
+
+        return best;
+    }
+
+    // --------------------------------------------------------
+    // Binned spatial split. Bins are equal slabs of the node
+    // box. A reference is clipped to every slab it touches and
+    // extends that slab's box; it counts as entering its first
+    // slab and leaving its last one.
+    // --------------------------------------------------------
+    split_candidate find_spatial_split(const std::vector<reference>& refs, const aabb& bounds) const {
+        const int bins = sbvh_settings::bins;
+        split_candidate best;
+
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& range = bounds.axis_interval(axis);
+            if (range.size() <= 0) continue;
+
+            double bin_width = range.size() / bins;
+            std::array<aabb, bins> boxes;
+            std::array<size_t, bins> entries{}, exits{};
+            boxes.fill(aabb::empty);
+
+            for (const auto& ref : refs) {
+                const interval& extent = ref.box.axis_interval(axis);
+                int first = bin_of(extent.min, range);
+                int last  = bin_of(extent.max, range);
+
+                for (int b = first; b <= last; b++) {
+                    aabb slab = ref.box;
+                    set_axis(slab, axis, interval(range.min + b * bin_width,
+                                                  range.min + (b + 1) * bin_width));
+                    aabb part = ref.object->clipped_box(ref.box.intersect(slab));
+                    if (!part.is_empty())
+                        boxes[b] = aabb(boxes[b], part);
+                }
+                entries[first]++;
+                exits[last]++;
+            }
+
+            std::array<aabb, bins> right_boxes;
+            std::array<size_t, bins> right_counts{};
+            aabb acc = aabb::empty;
+            size_t n = 0;
+            for (int b = bins - 1; b > 0; b--) {
+                acc = aabb(acc, boxes[b]);
+                n += exits[b];
+                right_boxes[b] = acc;
+                right_counts[b] = n;
+            }
+
+            acc = aabb::empty;
+            n = 0;
+            for (int b = 1; b < bins; b++) {
+                acc = aabb(acc, boxes[b - 1]);
+                n += entries[b - 1];
+                if (n == 0 || right_counts[b] == 0) continue;
+
+                double cost = acc.surface_area() * double(n)
+                            + right_boxes[b].surface_area() * double(right_counts[b]);
+                if (cost < best.cost) {
+                    best.cost = cost;
+                    best.axis = axis;
+                    best.plane = range.min + b * bin_width;
+                }
+            }
+        }
+
+        return best;
+    }
+
+    // --------------------------------------------------------
+    // Distributes references around a spatial split plane.
+    // References crossing the plane are clipped into two
+    // while the duplication budget lasts; after that they go
+    // whole to the side holding most of their box.
+    // --------------------------------------------------------
+    void split_spatially(const std::vector<reference>& refs, const aabb& bounds,
+                         const split_candidate& split,
+                         std::vector<reference>& left, std::vector<reference>& right) {
+        const int axis = split.axis;
+        const interval& range = bounds.axis_interval(axis);
+
+        for (const auto& ref : refs) {
+            const interval& extent = ref.box.axis_interval(axis);
+            if (extent.max <= split.plane) {
+                left.push_back(ref);
+            } else if (extent.min >= split.plane) {
+                right.push_back(ref);
+            } else if (reference_count < reference_limit) {
+                aabb left_slab = ref.box, right_slab = ref.box;
+                set_axis(left_slab,  axis, interval(range.min, split.plane));
+                set_axis(right_slab, axis, interval(split.plane, range.max));
+
+                aabb left_part  = ref.object->clipped_box(ref.box.intersect(left_slab));
+                aabb right_part = ref.object->clipped_box(ref.box.intersect(right_slab));
+
+                if (!left_part.is_empty())  left.push_back({ref.object, left_part});
+                if (!right_part.is_empty()) right.push_back({ref.object, right_part});
+                if (!left_part.is_empty() && !right_part.is_empty())
+                    reference_count++;
+            } else {
+                bool mostly_left = split.plane - extent.min > extent.max - split.plane;
+                (mostly_left ? left : right).push_back(ref);
+            }
+        }
+    }
+
+    static void set_axis(aabb& box, int axis, const interval& value) {
+        if (axis == 0) box.x = value;
+        else if (axis == 1) box.y = value;
+        else box.z = value;
+    }
+};
+
+// ------------------------------------------------------------
+// make_sbvh(list, settings)
+// Convenience wrapper that builds a spatial-split BVH.
+// ------------------------------------------------------------
+inline shared_ptr<bvh_node> make_sbvh(const hittable_list& list,
+                                      const sbvh_settings& settings = sbvh_settings()) {
+    return sbvh_builder(settings).build(list);
+}
+
+// ------------------------------------------------------------
+// report_spatial_splits(list)
+// Builds the scene with and without spatial splits and prints
+// the expected traversal cost (SAH) of both trees, together
+// with the number of duplicated references.
+// ------------------------------------------------------------
+inline void report_spatial_splits(const hittable_list& list, std::ostream& out = std::clog) {
+    sbvh_settings without;
+    without.spatial_splits = false;
+
+    sbvh_builder object_only(without), spatial;
+    double object_cost  = object_only.build(list)->sah_cost();
+    double spatial_cost = spatial.build(list)->sah_cost();
+
+    out << "BVH traversal cost (SAH) without spatial splits: " << object_cost << "\n"
+        << "BVH traversal cost (SAH) with spatial splits:    " << spatial_cost
+        << " (" << spatial.references() << " references for "
+        << spatial.primitives() << " primitives)\n";
+}
+
+#endif // SBVH_H
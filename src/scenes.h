@@ -0,0 +1,347 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ray_tracer.h"
+#include "bvh.h"
+#include "camera.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "material.h"
+#include "sphere.h"
+#include "tri.h"
+
+// ============================================================
+// Built-in scenes
+//
+// Each function fills 'scene' with objects and sets up 'cam'.
+// They are shared by the renderer (main.cpp) and the benchmark
+// and regression tools, which override resolution and sample
+// counts but keep the geometry and camera placement.
+// ============================================================
+
+// --------------------------------------
+// Scene: Many Spheres
+// Creates a ground plane sphere and a grid of random spheres
+// with either diffuse or metallic materials.
+// --------------------------------------
+inline void many_spheres_scene(hittable_list& scene, camera& cam) {
+    // Ground material (large sphere as the floor)
+    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    scene.add(make_scene_object<sphere>(vector3(0,-1000,0), 1000, ground_material));
+
+    // Generate random small spheres
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            auto choose_mat = random_double();
+            vector3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
+
+            // Avoid placing spheres too close to the big sphere at (4, 0.2, 0)
+            if ((center - vector3(4, 0.2, 0)).length() > 0.9) {
+                shared_ptr<material> sphere_material;
+
+                if (choose_mat < 0.8) {
+                    // Diffuse sphere
+                    auto albedo = color::random() * color::random();
+                    sphere_material = make_shared<lambertian>(albedo);
+                } else {
+                    // Metallic sphere
+                    auto albedo = color::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    sphere_material = make_shared<metal>(albedo, fuzz);
+                }
+
+                scene.add(make_scene_object<sphere>(center, 0.2, sphere_material));
+            }
+        }
+    }
+
+    // Three large example spheres
+    auto material1 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
+    scene.add(make_scene_object<sphere>(vector3(-4, 1, 0), 1.0, material1));
+
+    auto material2 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
+    scene.add(make_scene_object<sphere>(vector3(4, 1, 0), 1.0, material2));
+
+    // Camera setup
+    cam.aspect_ratio      = 16.0 / 9.0;
+    cam.image_width       = 400;
+    cam.samples_per_pixel = 100;
+    cam.max_depth         = 20;
+    cam.vfov              = 20;
+    cam.lookfrom          = vector3(13,2,3);
+    cam.lookat            = vector3(0,0,0);
+    cam.vup               = vector3(0,1,0);
+    cam.background        = color(0.7,0.8,1);
+}
+
+// --------------------------------------
+// Scene: Three Spheres
+// A simple scene with a ground sphere and three different materials.
+// --------------------------------------
+inline void three_spheres_scene(hittable_list& scene, camera& cam) {
+    // Materials
+    auto material_ground = make_shared<lambertian>(color(0.1, 0.2, 0.5));
+    auto material_center = make_shared<lambertian>(color(0.5, 0.1, 0.1));
+    auto material_left   = make_shared<metal>(color(0.8, 0.8, 0.8), 0.1);
+    auto material_right  = make_shared<metal>(color(0.8, 0.6, 0.2), 1.0);
+
+    // Objects
+    scene.add(make_scene_object<sphere>(vector3( 0.0, -100.5, -1.0), 100.0, material_ground));
+    scene.add(make_scene_object<sphere>(vector3( 0.0,    0.0, -1.2),   0.5, material_center));
+    scene.add(make_scene_object<sphere>(vector3(-1.0,    0.0, -1.0),   0.5, material_left));
+    scene.add(make_scene_object<sphere>(vector3( 1.0,    0.0, -1.0),   0.5, material_right));
+
+    // Camera setup
+    cam.aspect_ratio      = 16.0 / 9.0;
+    cam.image_width       = 400;
+    cam.samples_per_pixel = 100;
+    cam.max_depth         = 10;
+    cam.vfov              = 90;
+    cam.lookfrom          = vector3(0, 0, 0);
+    cam.lookat            = vector3(0, 0, -1);
+    cam.vup               = vector3(0, 1, 0);
+    cam.background        = color(0.7,0.8,1);
+}
+
+// --------------------------------------
+// Scene: Triangles
+// Creates colored triangles forming a cube-like enclosure.
+// --------------------------------------
+inline void tris_scene(hittable_list& scene, camera& cam) {
+    // Materials for each wall
+    auto left_red     = make_shared<lambertian>(color(1.0, 0.2, 0.2));
+    auto back_green   = make_shared<lambertian>(color(0.2, 1.0, 0.2));
+    auto right_blue   = make_shared<lambertian>(color(0.2, 0.2, 1.0));
+    auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
+    auto lower_teal   = make_shared<lambertian>(color(0.2, 0.8, 0.8));
+
+    // Add triangle faces (two per wall)
+    scene.add(make_scene_object<tri>(vector3(-3,-2, 5), vector3(-3, -2, 1), vector3(-3, 2, 5), left_red));
+    scene.add(make_scene_object<tri>(vector3(-3,2, 1),  vector3(-3, -2, 1), vector3(-3, 2, 5), left_red));
+
+    scene.add(make_scene_object<tri>(vector3(-2,-2, 0), vector3(2, -2, 0),  vector3(-2, 2, 0), back_green));
+    scene.add(make_scene_object<tri>(vector3(2,2, 0),   vector3(2, -2, 0),  vector3(-2, 2, 0), back_green));
+
+    scene.add(make_scene_object<tri>(vector3(3,-2, 1),  vector3(3,-2, 5),   vector3(3, 2, 1), right_blue));
+    scene.add(make_scene_object<tri>(vector3(3,2, 5),   vector3(3,-2, 5),   vector3(3, 2, 1), right_blue));
+
+    scene.add(make_scene_object<tri>(vector3(-2, 3, 1), vector3(2, 3, 1),   vector3(-2, 3, 5), upper_orange));
+    scene.add(make_scene_object<tri>(vector3(2, 3, 5),  vector3(2, 3, 1),   vector3(-2, 3, 5), upper_orange));
+
+    scene.add(make_scene_object<tri>(vector3(-2,-3, 5), vector3(2,-3, 5),   vector3(-2,-3, 1), lower_teal));
+    scene.add(make_scene_object<tri>(vector3(2,-3, 1),  vector3(2,-3, 5),   vector3(-2,-3, 1), lower_teal));
+
+    // Camera setup
+    cam.aspect_ratio      = 1.0;
+    cam.image_width       = 400;
+    cam.samples_per_pixel = 100;
+    cam.max_depth         = 50;
+    cam.vfov              = 80;
+    cam.lookfrom          = vector3(0,0,9);
+    cam.lookat            = vector3(0,0,0);
+    cam.vup               = vector3(0,1,0);
+    cam.background        = color(0.7,0.8,1);
+}
+
+// --------------------------------------
+// Scene: Skinny Triangles
+// Two crossing layers of long, thin planks laid diagonally
+// over a floor, each plank two triangles 200 times longer
+// than wide, like the trim and railings of architectural
+// models. Their bounding boxes are large and overlap heavily,
+// the case spatial splits (sbvh.h) are meant for.
+// --------------------------------------
+inline void skinny_tris_scene(hittable_list& scene, camera& cam, int planks_per_layer = 120) {
+    auto floor = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    scene.add(make_scene_object<tri>(vector3(-8, -0.5, -8), vector3(8, -0.5, -8), vector3(-8, -0.5, 8), floor));
+    scene.add(make_scene_object<tri>(vector3(8, -0.5, 8),   vector3(-8, -0.5, 8), vector3(8, -0.5, -8), floor));
+
+    const double diagonal = 1 / std::sqrt(2.0);
+    for (int layer = 0; layer < 2; layer++) {
+        auto mat = make_shared<lambertian>(layer == 0 ? color(0.6, 0.45, 0.3) : color(0.3, 0.4, 0.6));
+        vector3 along  = diagonal * vector3(1, 0, layer == 0 ? 1 : -1);
+        vector3 across = diagonal * vector3(1, 0, layer == 0 ? -1 : 1);
+        vector3 width  = 0.04 * across;
+
+        for (int k = 0; k < planks_per_layer; k++) {
+            double offset = 8.0 * (double(k) / (planks_per_layer - 1) - 0.5);
+            vector3 center = offset * across + vector3(0, 0.1 * layer, 0);
+            vector3 a = center - 4.0 * along, b = center + 4.0 * along;
+            scene.add(make_scene_object<tri>(a, b, b + width, mat));
+            scene.add(make_scene_object<tri>(a, b + width, a + width, mat));
+        }
+    }
+
+    cam.aspect_ratio      = 16.0 / 9.0;
+    cam.image_width       = 400;
+    cam.samples_per_pixel = 100;
+    cam.max_depth         = 10;
+    cam.vfov              = 40;
+    cam.lookfrom          = vector3(0, 6, 9);
+    cam.lookat            = vector3(0, 0, 0);
+    cam.vup               = vector3(0, 1, 0);
+    cam.background        = color(0.7, 0.8, 1);
+}
+
+// --------------------------------------
+// write_terrain_obj(filename, resolution)
+// Writes a procedural terrain as an OBJ file: a bumpy
+// resolution x resolution grid of quads, each split into two
+// triangles. Used to generate large-mesh test scenes that go
+// through the normal OBJ loader.
+// --------------------------------------
+inline void write_terrain_obj(const std::string& filename, int resolution) {
+    std::ofstream file(filename);
+    const double size = 10.0;
+
+    for (int z = 0; z <= resolution; z++) {
+        for (int x = 0; x <= resolution; x++) {
+            double u = size * (double(x) / resolution - 0.5);
+            double v = size * (double(z) / resolution - 0.5);
+            double height = 0.6 * std::sin(1.3 * u) * std::cos(0.9 * v)
+                          + 0.15 * std::sin(4.1 * u + 2.3 * v);
+            file << "v " << u << ' ' << height << ' ' << v << '\n';
+        }
+    }
+
+    auto index = [resolution](int x, int z) { return z * (resolution + 1) + x + 1; };
+    for (int z = 0; z < resolution; z++) {
+        for (int x = 0; x < resolution; x++) {
+            file << "f " << index(x, z) << ' ' << index(x + 1, z) << ' ' << index(x, z + 1) << '\n';
+            file << "f " << index(x + 1, z) << ' ' << index(x + 1, z + 1) << ' ' << index(x, z + 1) << '\n';
+        }
+    }
+}
+
+// --------------------------------------
+// Scene: Large Mesh (camera only)
+// Camera for the terrain written by write_terrain_obj(); the
+// mesh itself is loaded with load_obj_file().
+// --------------------------------------
+inline void large_mesh_camera(camera& cam) {
+    cam.aspect_ratio      = 16.0 / 9.0;
+    cam.image_width       = 400;
+    cam.samples_per_pixel = 100;
+    cam.max_depth         = 10;
+    cam.vfov              = 40;
+    cam.lookfrom          = vector3(0, 6, 11);
+    cam.lookat            = vector3(0, 0, 0);
+    cam.vup               = vector3(0, 1, 0);
+    cam.background        = color(0.7, 0.8, 1);
+}
+
+// --------------------------------------
+// Scene: Many Lights
+// A dark room-like scene lit only by a grid of small
+// emissive spheres hovering over diffuse and metal spheres.
+// --------------------------------------
+inline void many_lights_scene(hittable_list& scene, camera& cam, int lights_per_side = 10) {
+    scene.add(make_scene_object<sphere>(vector3(0,-1000,0), 1000, make_shared<lambertian>(color(0.6, 0.6, 0.6))));
+
+    for (int a = 0; a < lights_per_side; a++) {
+        for (int b = 0; b < lights_per_side; b++) {
+            double x = 8.0 * (double(a) / (lights_per_side - 1) - 0.5);
+            double z = 8.0 * (double(b) / (lights_per_side - 1) - 0.5);
+
+            auto light = make_shared<diffuse_light>(4.0 * color::random(0.3, 1));
+            scene.add(make_scene_object<sphere>(vector3(x, 2.0, z), 0.1, light));
+
+            shared_ptr<material> mat;
+            if ((a + b) % 3 == 0)
+                mat = make_shared<metal>(color::random(0.5, 1), random_double(0, 0.3));
+            else
+                mat = make_shared<lambertian>(color::random(0.2, 0.9));
+            scene.add(make_scene_object<sphere>(vector3(x + 0.3, 0.3, z - 0.2), 0.3, mat));
+        }
+    }
+
+    cam.aspect_ratio      = 16.0 / 9.0;
+    cam.image_width       = 400;
+    cam.samples_per_pixel = 100;
+    cam.max_depth         = 10;
+    cam.vfov              = 35;
+    cam.lookfrom          = vector3(0, 7, 12);
+    cam.lookat            = vector3(0, 0, 0);
+    cam.vup               = vector3(0, 1, 0);
+    cam.background        = color(0.02, 0.02, 0.03);
+}
+
+// --------------------------------------
+// Scene: Mesh Cave
+// Two instances of 'mesh' (e.g. the terrain from
+// write_terrain_obj, as a BVH): a floor and an upside-down
+// ceiling, lit by one small light between them. Almost every
+// path keeps bouncing between the two surfaces, so secondary
+// rays dominate the work, unlike the open terrain where most
+// bounces escape to the sky.
+// --------------------------------------
+inline void mesh_cave_scene(hittable_list& scene, camera& cam, shared_ptr<hittable> mesh) {
+    auto rock = make_shared<lambertian>(color(0.7, 0.65, 0.6));
+    scene.add(make_scene_object<instance>(mesh, transform::translate(vector3(0, 0, 0)), rock));
+    scene.add(make_scene_object<instance>(mesh, transform::translate(vector3(0, 2.5, 0))
+                                              * transform::scale(vector3(1, -1, 1)), rock));
+    scene.add(make_scene_object<sphere>(vector3(0, 1.2, -2), 0.4, make_shared<diffuse_light>(color(8, 8, 8))));
+
+    cam.aspect_ratio      = 16.0 / 9.0;
+    cam.image_width       = 400;
+    cam.samples_per_pixel = 100;
+    cam.max_depth         = 10;
+    cam.vfov              = 60;
+    cam.lookfrom          = vector3(0, 1.2, 4.5);
+    cam.lookat            = vector3(0, 1.2, 0);
+    cam.vup               = vector3(0, 1, 0);
+    cam.background        = color(0.7, 0.8, 1);
+}
+
+// --------------------------------------
+// Scene: Turntable
+// Two counter-rotating rings of instances of one small sphere
+// cluster (shared object-space geometry) over a ground sphere.
+// The ring instances are appended to 'instances' in ring
+// order; turntable_pose() moves them to an animation angle.
+// --------------------------------------
+inline void turntable_pose(const std::vector<shared_ptr<instance>>& instances, double angle) {
+    const size_t per_ring = instances.size() / 2;
+    for (size_t n = 0; n < instances.size(); n++) {
+        bool inner = n < per_ring;
+        double radius = inner ? 2.0 : 4.0;
+        double speed  = inner ? 1.0 : -0.5;
+        instances[n]->set_transform(transform::rotate_y(speed * angle + 360.0 * double(n % per_ring) / per_ring)
+                                  * transform::translate(vector3(radius, 0, 0)));
+    }
+}
+
+inline void turntable_scene(hittable_list& scene, camera& cam,
+                            std::vector<shared_ptr<instance>>& instances, int per_ring = 12) {
+    scene.add(make_scene_object<sphere>(vector3(0,-1000,0), 1000,
+                                        make_shared<lambertian>(color(0.5, 0.5, 0.5))));
+
+    hittable_list cluster;
+    cluster.add(make_scene_object<sphere>(vector3( 0.0, 0.3, 0.0), 0.30, make_shared<lambertian>(color(0.8, 0.3, 0.2))));
+    cluster.add(make_scene_object<sphere>(vector3( 0.3, 0.7, 0.0), 0.15, make_shared<metal>(color(0.8, 0.8, 0.8), 0.05)));
+    cluster.add(make_scene_object<sphere>(vector3(-0.3, 0.7, 0.0), 0.15, make_shared<metal>(color(0.8, 0.6, 0.2), 0.3)));
+    auto shared_cluster = make_scene_object<bvh_node>(cluster);
+
+    for (int k = 0; k < 2 * per_ring; k++) {
+        auto inst = make_scene_object<instance>(shared_cluster, transform());
+        instances.push_back(inst);
+        scene.add(inst);
+    }
+    turntable_pose(instances, 0);
+
+    cam.aspect_ratio      = 16.0 / 9.0;
+    cam.image_width       = 400;
+    cam.samples_per_pixel = 50;
+    cam.max_depth         = 10;
+    cam.vfov              = 35;
+    cam.lookfrom          = vector3(0, 6, 12);
+    cam.lookat            = vector3(0, 0, 0);
+    cam.vup               = vector3(0, 1, 0);
+    cam.background        = color(0.7, 0.8, 1);
+}
+
+#endif // SCENES_H
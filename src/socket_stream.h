@@ -0,0 +1,129 @@
+#ifndef SOCKET_STREAM_H
+#define SOCKET_STREAM_H
+
+// ============================================================
+// Sockets as iostreams (POSIX only)
+//
+// The render daemon and the distributed renderer talk over
+// sockets in lines of text, plus raw pixel data for the tile
+// results. socket_buffer lets both use std::istream and
+// std::ostream (getline, >>, read, write) on a connected
+// socket. tcp_listen() and tcp_connect() open the TCP ends.
+// ============================================================
+#ifndef _WIN32
+
+#include <streambuf>
+#include <string>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// ------------------------------------------------------
+// socket_buffer: stream buffer over a connected socket.
+// A failed receive (peer gone, or a receive timeout set
+// on the socket) reads as end of file; a failed send
+// makes the stream fail.
+// ------------------------------------------------------
+class socket_buffer : public std::streambuf {
+  public:
+    explicit socket_buffer(int fd) : fd(fd) {
+        setg(input, input, input);
+        setp(output, output + sizeof(output));
+    }
+    ~socket_buffer() override { sync(); }
+
+  protected:
+    int_type underflow() override {
+        ssize_t received = ::recv(fd, input, sizeof(input), 0);
+        if (received <= 0) return traits_type::eof();
+        setg(input, input, input + received);
+        return traits_type::to_int_type(input[0]);
+    }
+
+    int_type overflow(int_type c) override {
+        if (sync() != 0) return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+        for (char* p = pbase(); p < pptr();) {
+            ssize_t sent = ::send(fd, p, size_t(pptr() - p), send_flags);
+            if (sent <= 0) return -1;  // Peer gone
+            p += sent;
+        }
+        setp(output, output + sizeof(output));
+        return 0;
+    }
+
+  private:
+#ifdef MSG_NOSIGNAL
+    static constexpr int send_flags = MSG_NOSIGNAL;  // A closed peer is an error, not SIGPIPE
+#else
+    static constexpr int send_flags = 0;
+#endif
+    int fd;
+    char input[64 * 1024];
+    char output[64 * 1024];
+};
+
+// ------------------------------------------------------
+// tcp_listen(port)
+// Listening socket on 'port' of all interfaces, or -1
+// ------------------------------------------------------
+inline int tcp_listen(int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(uint16_t(port));
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 64) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// ------------------------------------------------------
+// tcp_connect(host, port)
+// Connected socket to host:port, or -1. Nagle's delay is
+// turned off: every message is a whole line or tile.
+// ------------------------------------------------------
+inline int tcp_connect(const std::string& host, int port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0) return -1;
+
+    int fd = -1;
+    for (addrinfo* a = found; a && fd < 0; a = a->ai_next) {
+        fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ::freeaddrinfo(found);
+
+    if (fd >= 0) {
+        int no_delay = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    }
+    return fd;
+}
+
+#endif // _WIN32
+
+#endif // SOCKET_STREAM_H
@@ -3,6 +3,8 @@
 
 #include "hittable.h"
 
+#include <utility>
+
 // ------------------------------------------------------
 // Class: sphere
 // A basic 3D sphere object that can be intersected by rays.
@@ -18,9 +20,9 @@ public:
     //
     // Also precomputes the axis-aligned bounding box (AABB).
     // ------------------------------------------------------
-    sphere(const vector3& center, double radius, shared_ptr<material> mat)
+    sphere(const vector3& center, real radius, shared_ptr<material> mat)
         : center(center),
-          radius(std::fmax(0, radius)), // avoid negative radius
+          radius(std::fmax(real(0), radius)), // avoid negative radius
           mat(mat) 
     {
         auto rvec = vector3(radius, radius, radius);
@@ -36,9 +38,20 @@ public:
     // Ray: P(t) = origin + t * direction
     // Sphere: (P - C) • (P - C) = r²
     //
+    // Both steps avoid subtracting nearly equal numbers, which
+    // loses most of the digits in float for large spheres (the
+    // radius-1000 ground) or distant ones:
+    //  - the discriminant h² - a·c is computed as
+    //    a·(r² - |oc - (h/a)·d|²), where the vector is the
+    //    offset from the center to the closest point on the ray
+    //  - the two roots come from q = h ± sqrt(disc) with the
+    //    sign of h, as c/q and q/a, instead of (h ∓ sqrt)/a
+    //
     // Returns true if a hit is found and fills in hit_record.
     // ------------------------------------------------------
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        RT_COUNT(primitives_tested);
+
         // Vector from ray origin to sphere center
         vector3 oc = center - r.origin();
 
@@ -48,16 +61,22 @@ public:
         auto c = oc.length_squared() - radius * radius;
 
         // Discriminant check
-        auto discriminant = h * h - a * c;
+        vector3 to_closest = oc - (h / a) * r.direction();
+        auto discriminant = a * (radius * radius - to_closest.length_squared());
         if (discriminant < 0)
             return false; // no intersection
 
         auto sqrtd = std::sqrt(discriminant);
+        auto q = h + std::copysign(sqrtd, h);
+        if (q == 0)
+            return false; // degenerate: zero direction, or origin at the center of a point sphere
 
         // Find the nearest root in the valid range
-        auto root = (h - sqrtd) / a;
+        auto near_root = c / q, far_root = q / a;
+        if (near_root > far_root) std::swap(near_root, far_root);
+        auto root = near_root;
         if (!ray_t.surrounds(root)) {
-            root = (h + sqrtd) / a;
+            root = far_root;
             if (!ray_t.surrounds(root))
                 return false;
         }
@@ -81,9 +100,13 @@ public:
     // ------------------------------------------------------
     aabb bounding_box() const override { return bbox; }
 
+    shared_ptr<hittable> copy_into(scene_arena& arena) const override {
+        return arena.make<sphere>(*this);
+    }
+
 private:
     vector3 center;                 // Sphere center
-    double radius;                  // Sphere radius
+    real radius;                    // Sphere radius
     shared_ptr<material> mat;       // Material pointer
     aabb bbox;                      // Precomputed bounding box
 };
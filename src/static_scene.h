@@ -0,0 +1,247 @@
+#ifndef STATIC_SCENE_H
+#define STATIC_SCENE_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "sphere.h"
+#include "tri.h"
+
+#include <cstdint>
+#include <tuple>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================
+// static_scene<Primitives...>: a BVH over a closed set of
+// primitive types
+//
+// bvh_node reaches its children and primitives through
+// virtual calls at every level. When a scene only holds types
+// known at compile time (spheres and triangles for anything
+// input.h loads), the same tree can be stored flat:
+//
+//  - nodes in one array, each with its box and two child
+//    references: a node index, or (top bit set) a primitive
+//    type and index
+//  - primitives by value, one array per type (a variant
+//    array would pad every sphere to the size of a triangle)
+//
+// Traversal is a loop with a small stack, and primitives are
+// tested by calling their hit() non-virtually, so the whole
+// intersection inlines into the caller. The class is final:
+// code that holds a static_scene by its own type (such as the
+// camera's render templates) calls hit() without a vtable.
+//
+// The tree is converted from an existing bvh_node and
+// traversed in the same order (left child, then right, with
+// the t range narrowed by earlier hits), so hits are
+// identical to the bvh_node's. from_bvh() returns nullptr for
+// trees that hold other hittables (instances, lists, ...);
+// render those through the virtual interface.
+// ============================================================
+
+// ------------------------------------------------------
+// static_primitives<Primitives...>: the primitive arrays of
+// a flat scene, one per type, and the child references that
+// point into them (shared by the flat tree layouts)
+// ------------------------------------------------------
+template <typename... Primitives>
+class static_primitives {
+    static_assert(sizeof...(Primitives) >= 1 && sizeof...(Primitives) <= 4,
+                  "child references have two bits for the primitive type");
+
+  public:
+    // Child reference: primitive_bit | type << type_shift | index
+    static constexpr uint32_t primitive_bit = uint32_t(1) << 31;
+    static constexpr int type_shift = 29;
+    static constexpr uint32_t index_mask = (uint32_t(1) << type_shift) - 1;
+
+    static bool is_primitive(uint32_t ref) { return (ref & primitive_bit) != 0; }
+
+    // --------------------------------------------------------
+    // Sets 'ref' to the copy of 'object', copying it on first
+    // sight ('index' remembers objects referenced from several
+    // leaves, as spatial splits make them). Returns false if
+    // its exact type is none of Primitives.
+    // --------------------------------------------------------
+    bool add(const hittable& object, std::unordered_map<const hittable*, uint32_t>& index, uint32_t& ref) {
+        auto found = index.find(&object);
+        if (found != index.end()) {
+            ref = found->second;
+            return true;
+        }
+        if (!add_primitive(object, ref)) return false;
+        index[&object] = ref;
+        return true;
+    }
+
+    // Tests the primitive behind 'ref' (non-virtually)
+    bool hit(uint32_t ref, const ray& r, interval ray_t, hit_record& rec) const {
+        return hit_primitive((ref >> type_shift) & 3, ref & index_mask, r, ray_t, rec);
+    }
+
+    size_t size() const {
+        return std::apply([](const auto&... arrays) { return (arrays.size() + ...); }, arrays);
+    }
+
+    // Bytes held by the primitive arrays
+    size_t bytes() const {
+        return std::apply([](const auto&... arrays) {
+            return ((arrays.size() * sizeof(arrays[0])) + ...);
+        }, arrays);
+    }
+
+  private:
+    std::tuple<std::vector<Primitives>...> arrays;
+
+    // --------------------------------------------------------
+    // Copies 'object' into the array of its type if its exact
+    // type is Primitives[I] or a later one, and sets 'ref'
+    // --------------------------------------------------------
+    template <size_t I = 0>
+    bool add_primitive(const hittable& object, uint32_t& ref) {
+        if constexpr (I < sizeof...(Primitives)) {
+            using T = std::tuple_element_t<I, std::tuple<Primitives...>>;
+            if (typeid(object) != typeid(T)) return add_primitive<I + 1>(object, ref);
+            auto& array = std::get<I>(arrays);
+            if (array.size() > index_mask) return false;
+            ref = primitive_bit | uint32_t(I) << type_shift | uint32_t(array.size());
+            array.push_back(static_cast<const T&>(object));
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    // --------------------------------------------------------
+    // Tests primitive 'index' of type 'type': a chain of type
+    // checks ending in a direct, qualified call to the
+    // primitive's hit() (no vtable lookup, inlinable)
+    // --------------------------------------------------------
+    template <size_t I = 0>
+    bool hit_primitive(uint32_t type, uint32_t index, const ray& r, interval ray_t, hit_record& rec) const {
+        if constexpr (I + 1 < sizeof...(Primitives)) {
+            if (type != I) return hit_primitive<I + 1>(type, index, r, ray_t, rec);
+        }
+        using T = std::tuple_element_t<I, std::tuple<Primitives...>>;
+        return std::get<I>(arrays)[index].T::hit(r, ray_t, rec);
+    }
+};
+
+template <typename... Primitives>
+class static_scene final : public hittable {
+  public:
+    // --------------------------------------------------------
+    // from_bvh(root)
+    // Flattens 'root', or returns nullptr if one of its leaves
+    // is not exactly one of Primitives (subclasses included)
+    // or the tree is deeper than the traversal stack.
+    // --------------------------------------------------------
+    static shared_ptr<static_scene> from_bvh(const bvh_node& root) {
+        auto scene = shared_ptr<static_scene>(new static_scene());
+        int depth = 0;
+        std::unordered_map<const hittable*, uint32_t> primitive_index;
+        if (!scene->flatten(root, primitive_index, 1, depth) || depth >= stack_size)
+            return nullptr;
+        scene->bbox = root.bounding_box();
+        return scene;
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        uint32_t stack[stack_size];
+        int top = 0;
+        stack[top++] = 0;  // Root node
+        bool hit_anything = false;
+
+        while (top > 0) {
+            uint32_t ref = stack[--top];
+            interval range(ray_t.min, hit_anything ? rec.t : ray_t.max);
+
+            if (primitive_arrays::is_primitive(ref)) {
+                if (primitives.hit(ref, r, range, rec))
+                    hit_anything = true;
+                continue;
+            }
+
+            const node& n = nodes[ref];
+            RT_COUNT(boxes_tested);
+            if (!n.box.hit(r, range))
+                continue;
+            RT_COUNT(nodes_visited);
+
+            // Right is pushed first so the left subtree is finished first
+            if (n.child[1] != n.child[0]) stack[top++] = n.child[1];
+            stack[top++] = n.child[0];
+        }
+        return hit_anything;
+    }
+
+    // Packets are traced ray by ray, each through the non-virtual hit() above
+    void hit_packet(ray_packet& packet, interval ray_t,
+                    const int* active, int count) const override {
+        for (int n = 0; n < count; n++) {
+            int k = active[n];
+            if (hit(packet.rays[k], interval(ray_t.min, packet.t_max[k]), packet.records[k])) {
+                packet.t_max[k] = packet.records[k].t;
+                packet.hit[k] = true;
+            }
+        }
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    size_t node_count() const { return nodes.size(); }
+    size_t node_bytes() const { return nodes.size() * sizeof(node); }
+    size_t primitive_count() const { return primitives.size(); }
+
+  private:
+    using primitive_arrays = static_primitives<Primitives...>;
+    static constexpr int stack_size = 64;
+
+    struct node {
+        aabb box;
+        uint32_t child[2];  // Node index or primitive reference
+    };
+
+    std::vector<node> nodes;
+    primitive_arrays primitives;
+    aabb bbox;
+
+    static_scene() = default;
+
+    // --------------------------------------------------------
+    // Appends 'source' and its subtree in depth-first order
+    // (so the left child of a node directly follows it) and
+    // tracks the deepest level. Returns false on a leaf of an
+    // unsupported type.
+    // --------------------------------------------------------
+    bool flatten(const bvh_node& source, std::unordered_map<const hittable*, uint32_t>& primitive_index,
+                 int level, int& depth) {
+        depth = std::max(depth, level);
+        uint32_t index = uint32_t(nodes.size());
+        nodes.push_back({ source.bounding_box(), { 0, 0 } });
+
+        const shared_ptr<hittable>* children[2] = { &source.left_child(), &source.right_child() };
+        for (int side = 0; side < 2; side++) {
+            const hittable* child = children[side]->get();
+            uint32_t ref;
+            if (side == 1 && child == children[0]->get()) {
+                ref = nodes[index].child[0];  // Single-object leaf
+            } else if (auto inner = dynamic_cast<const bvh_node*>(child)) {
+                ref = uint32_t(nodes.size());
+                if (!flatten(*inner, primitive_index, level + 1, depth)) return false;
+            } else if (!primitives.add(*child, primitive_index, ref)) {
+                return false;
+            }
+            nodes[index].child[side] = ref;
+        }
+        return true;
+    }
+};
+
+// The closed set of everything input.h and the built-in scenes create
+using sphere_tri_scene = static_scene<sphere, tri>;
+
+#endif // STATIC_SCENE_H
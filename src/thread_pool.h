@@ -0,0 +1,108 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ============================================================
+// thread_pool: a fixed set of worker threads
+//
+// camera::render_framebuffer() starts a thread per core for
+// every image and joins them at the end. That is fine for one
+// render per process, but a long-running process (the render
+// daemon) renders many small images, possibly several at once.
+// A pool starts its threads once; parallel_for() splits a job
+// into tasks that any idle worker picks up, so concurrent jobs
+// share the cores instead of oversubscribing them.
+//
+// parallel_for() may be called from several threads at once,
+// but not from inside a task (the caller waits for its tasks
+// without running any).
+// ============================================================
+class thread_pool {
+  public:
+    explicit thread_pool(unsigned threads = std::thread::hardware_concurrency()) {
+        threads = std::max(1u, threads);
+        for (unsigned t = 0; t < threads; t++)
+            workers.emplace_back([this] { work(); });
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    // --------------------------------------------------------
+    // parallel_for(count, task)
+    // Runs task(0) ... task(count - 1) on the workers and
+    // returns when all of them have finished
+    // --------------------------------------------------------
+    void parallel_for(size_t count, const std::function<void(size_t)>& task) {
+        if (count == 0) return;
+
+        struct batch {
+            std::mutex mutex;
+            std::condition_variable done;
+            size_t remaining;
+        } state;
+        state.remaining = count;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t k = 0; k < count; k++) {
+                queue.emplace_back([&state, &task, k] {
+                    task(k);
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    if (--state.remaining == 0) state.done.notify_one();
+                });
+            }
+        }
+        wake.notify_all();
+
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.done.wait(lock, [&state] { return state.remaining == 0; });
+    }
+
+  private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;  // Tasks of all jobs, oldest first
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;  // Stopping, and nothing left to run
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+// The process-wide pool, started on first use with one thread per core
+inline thread_pool& shared_thread_pool() {
+    static thread_pool pool;
+    return pool;
+}
+
+#endif // THREAD_POOL_H
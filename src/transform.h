@@ -0,0 +1,152 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "ray_tracer.h"
+
+// ============================================================
+// transform: 3D affine transformation
+//
+// Stored as the upper 3x4 part of a 4x4 matrix (the bottom row is
+// always 0 0 0 1). The left 3x3 block holds rotation/scale and the
+// last column holds the translation.
+//
+// Transforms are combined with operator*, where (a * b) applies b
+// first and then a.
+// ============================================================
+class transform {
+  public:
+    real m[3][4];   // Row-major 3x4 matrix
+
+    // --------------------------------------------------------
+    // Default constructor: identity transform
+    // --------------------------------------------------------
+    transform() : m{{1,0,0,0}, {0,1,0,0}, {0,0,1,0}} {}
+
+    // --------------------------------------------------------
+    // Factory helpers for the basic transforms.
+    // Rotation angles are given in degrees.
+    // --------------------------------------------------------
+    static transform translate(const vector3& offset) {
+        transform t;
+        t.m[0][3] = offset.x();
+        t.m[1][3] = offset.y();
+        t.m[2][3] = offset.z();
+        return t;
+    }
+
+    static transform scale(const vector3& factor) {
+        transform t;
+        t.m[0][0] = factor.x();
+        t.m[1][1] = factor.y();
+        t.m[2][2] = factor.z();
+        return t;
+    }
+
+    static transform rotate_x(double degrees) {
+        auto c = std::cos(degrees_to_radians(degrees));
+        auto s = std::sin(degrees_to_radians(degrees));
+        transform t;
+        t.m[1][1] = c;  t.m[1][2] = -s;
+        t.m[2][1] = s;  t.m[2][2] = c;
+        return t;
+    }
+
+    static transform rotate_y(double degrees) {
+        auto c = std::cos(degrees_to_radians(degrees));
+        auto s = std::sin(degrees_to_radians(degrees));
+        transform t;
+        t.m[0][0] = c;  t.m[0][2] = s;
+        t.m[2][0] = -s; t.m[2][2] = c;
+        return t;
+    }
+
+    static transform rotate_z(double degrees) {
+        auto c = std::cos(degrees_to_radians(degrees));
+        auto s = std::sin(degrees_to_radians(degrees));
+        transform t;
+        t.m[0][0] = c;  t.m[0][1] = -s;
+        t.m[1][0] = s;  t.m[1][1] = c;
+        return t;
+    }
+
+    // --------------------------------------------------------
+    // Apply the transform to a point (translation included).
+    // --------------------------------------------------------
+    vector3 point(const vector3& p) const {
+        return vector3(
+            m[0][0]*p[0] + m[0][1]*p[1] + m[0][2]*p[2] + m[0][3],
+            m[1][0]*p[0] + m[1][1]*p[1] + m[1][2]*p[2] + m[1][3],
+            m[2][0]*p[0] + m[2][1]*p[1] + m[2][2]*p[2] + m[2][3]
+        );
+    }
+
+    // --------------------------------------------------------
+    // Apply the transform to a direction (translation ignored).
+    // --------------------------------------------------------
+    vector3 vector(const vector3& v) const {
+        return vector3(
+            m[0][0]*v[0] + m[0][1]*v[1] + m[0][2]*v[2],
+            m[1][0]*v[0] + m[1][1]*v[1] + m[1][2]*v[2],
+            m[2][0]*v[0] + m[2][1]*v[1] + m[2][2]*v[2]
+        );
+    }
+
+    // --------------------------------------------------------
+    // Multiply a vector by the transposed 3x3 block.
+    // Called on the *inverse* transform this maps surface normals
+    // from object space to world space.
+    // --------------------------------------------------------
+    vector3 transposed_vector(const vector3& v) const {
+        return vector3(
+            m[0][0]*v[0] + m[1][0]*v[1] + m[2][0]*v[2],
+            m[0][1]*v[0] + m[1][1]*v[1] + m[2][1]*v[2],
+            m[0][2]*v[0] + m[1][2]*v[1] + m[2][2]*v[2]
+        );
+    }
+
+    // --------------------------------------------------------
+    // Inverse of the affine transform.
+    // The 3x3 block is inverted via its adjugate; the translation
+    // becomes -inv(A) * t.
+    // --------------------------------------------------------
+    transform inverse() const {
+        real det =
+              m[0][0] * (m[1][1]*m[2][2] - m[1][2]*m[2][1])
+            - m[0][1] * (m[1][0]*m[2][2] - m[1][2]*m[2][0])
+            + m[0][2] * (m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+        real inv_det = 1 / det;
+
+        transform r;
+        r.m[0][0] =  (m[1][1]*m[2][2] - m[1][2]*m[2][1]) * inv_det;
+        r.m[0][1] = -(m[0][1]*m[2][2] - m[0][2]*m[2][1]) * inv_det;
+        r.m[0][2] =  (m[0][1]*m[1][2] - m[0][2]*m[1][1]) * inv_det;
+        r.m[1][0] = -(m[1][0]*m[2][2] - m[1][2]*m[2][0]) * inv_det;
+        r.m[1][1] =  (m[0][0]*m[2][2] - m[0][2]*m[2][0]) * inv_det;
+        r.m[1][2] = -(m[0][0]*m[1][2] - m[0][2]*m[1][0]) * inv_det;
+        r.m[2][0] =  (m[1][0]*m[2][1] - m[1][1]*m[2][0]) * inv_det;
+        r.m[2][1] = -(m[0][0]*m[2][1] - m[0][1]*m[2][0]) * inv_det;
+        r.m[2][2] =  (m[0][0]*m[1][1] - m[0][1]*m[1][0]) * inv_det;
+
+        vector3 t = r.vector(vector3(m[0][3], m[1][3], m[2][3]));
+        r.m[0][3] = -t.x();
+        r.m[1][3] = -t.y();
+        r.m[2][3] = -t.z();
+        return r;
+    }
+};
+
+// ------------------------------------------------------
+// Compose two transforms: (a * b) applies b, then a.
+// ------------------------------------------------------
+inline transform operator*(const transform& a, const transform& b) {
+    transform r;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            r.m[i][j] = a.m[i][0]*b.m[0][j] + a.m[i][1]*b.m[1][j] + a.m[i][2]*b.m[2][j];
+        }
+        r.m[i][3] += a.m[i][3];
+    }
+    return r;
+}
+
+#endif // TRANSFORM_H
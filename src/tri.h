@@ -3,6 +3,8 @@
 
 #include "hittable.h"
 
+#include <algorithm>
+
 // ------------------------------------------------------
 // Class: tri
 // A single triangle object that can be hit by rays.
@@ -25,18 +27,32 @@ public:
     tri(const vector3& v0, const vector3& v1, const vector3& v2, shared_ptr<material> mat)
         : v0(v0), v1(v1), v2(v2), mat(mat) 
     {
+        precompute(v0, v1, v2, normal, w, D);
+
+        // Precompute bounding box
+        set_bounding_box();
+    }
+
+    // ------------------------------------------------------
+    // precompute()
+    // The normal, plane constant D and barycentric helper w
+    // of the triangle v0, v1, v2, as intersect() uses them
+    // ------------------------------------------------------
+    static void precompute(const vector3& v0, const vector3& v1, const vector3& v2,
+                           vector3& normal, vector3& w, real& D) {
         // Compute normal using cross product of two edges
         vector3 n = cross(v1 - v0, v2 - v0);
-        normal = n.normalize();
+        real n_squared = dot(n, n);
+
+        // A degenerate (zero-area) triangle keeps a zero normal and w,
+        // which hit() rejects as parallel to every ray, instead of NaNs
+        normal = n_squared > 0 ? n.normalize() : vector3();
 
         // Plane equation: dot(normal, P) = D
         D = dot(normal, v0);
 
         // Precompute helper vector for barycentric coordinates
-        w = n / dot(n, n);
-
-        // Precompute bounding box
-        set_bounding_box();
+        w = n_squared > 0 ? n / n_squared : vector3();
     }
 
     // ------------------------------------------------------
@@ -53,6 +69,55 @@ public:
     // Return the triangle's bounding box
     aabb bounding_box() const override { return bbox; }
 
+    shared_ptr<hittable> copy_into(scene_arena& arena) const override {
+        return arena.make<tri>(*this);
+    }
+
+    // ------------------------------------------------------
+    // clipped_box()
+    // Exact bounds of the part of the triangle inside 'clip'.
+    // The triangle is clipped against the six box planes
+    // (Sutherland-Hodgman) and the box of the remaining
+    // polygon is returned. Long, thin triangles get much
+    // tighter boxes this way than by overlapping AABBs.
+    // ------------------------------------------------------
+    aabb clipped_box(const aabb& clip) const override {
+        // Each plane adds at most one vertex: 3 + 6 = 9
+        vector3 polygon[9] = {v0, v1, v2}, next[9];
+        int count = 3;
+
+        for (int axis = 0; axis < 3 && count > 0; axis++) {
+            for (int side = 0; side < 2 && count > 0; side++) {
+                const interval& range = clip.axis_interval(axis);
+                double plane = side == 0 ? range.min : range.max;
+                auto inside = [&](const vector3& p) {
+                    return side == 0 ? p[axis] >= plane : p[axis] <= plane;
+                };
+
+                int next_count = 0;
+                for (int i = 0; i < count; i++) {
+                    const vector3& a = polygon[i];
+                    const vector3& b = polygon[(i + 1) % count];
+                    if (inside(a)) next[next_count++] = a;
+                    if (inside(a) != inside(b)) {
+                        double t = (plane - a[axis]) / (b[axis] - a[axis]);
+                        vector3 p = a + t * (b - a);
+                        p[axis] = plane; // Avoid round-off outside the plane
+                        next[next_count++] = p;
+                    }
+                }
+
+                count = next_count;
+                std::copy(next, next + count, polygon);
+            }
+        }
+
+        aabb result = aabb::empty;
+        for (int i = 0; i < count; i++)
+            result = aabb(result, aabb(polygon[i], polygon[i]));
+        return result.intersect(clip);
+    }
+
     // ------------------------------------------------------
     // hit()
     // Checks if a ray intersects the triangle.
@@ -62,10 +127,30 @@ public:
     //  2. Solve for t (distance along ray to intersection point on plane).
     //  3. Reject if t is outside valid interval.
     //  4. Compute barycentric coordinates (alpha, beta).
-    //  5. Reject if point is outside the triangle.
+    //  5. Reject if point is outside the triangle, allowing a
+    //     few units of rounding error (edge_tolerance) so that
+    //     rays through a shared edge cannot slip between two
+    //     neighbors (visible as cracks in float builds).
     //  6. Fill hit_record with intersection data.
     // ------------------------------------------------------
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!intersect(r, ray_t, v0, v1, v2, normal, w, D, rec)) return false;
+        rec.mat = mat;
+        return true;
+    }
+
+    // ------------------------------------------------------
+    // intersect()
+    // The test of hit() on the vertices and the values from
+    // precompute(), for containers that store triangles
+    // without a material and bounds of their own. Fills in
+    // everything in 'rec' except the material.
+    // ------------------------------------------------------
+    static bool intersect(const ray& r, const interval& ray_t, const vector3& v0, const vector3& v1,
+                          const vector3& v2, const vector3& normal, const vector3& w, real D,
+                          hit_record& rec) {
+        RT_COUNT(primitives_tested);
+
         auto denom = dot(normal, r.direction());
 
         // If denom is near zero, ray is parallel to triangle plane
@@ -86,25 +171,26 @@ public:
         auto beta  = dot(w, cross(v1 - v0, planar_hitpt_vector));
 
         // Reject if point is outside triangle
-        if ((alpha < 0) || (beta < 0) || (alpha + beta > 1))
+        if ((alpha < -edge_tolerance) || (beta < -edge_tolerance) || (alpha + beta > 1 + edge_tolerance))
             return false;
 
         // Hit confirmed — store intersection info
         rec.t = t;
         rec.p = intersection;
-        rec.mat = mat;
         rec.set_face_normal(r, normal);
 
         return true;
     }
 
 private:
+    static constexpr real edge_tolerance = 16 * std::numeric_limits<real>::epsilon();
+
     vector3 v0, v1, v2;          // Triangle vertices
     shared_ptr<material> mat;    // Material
     aabb bbox;                   // Bounding box
     vector3 normal;              // Unit normal vector
     vector3 w;                   // Precomputed for barycentric coordinate calc
-    double D;                    // Plane equation constant
+    real D;                      // Plane equation constant
 };
 
 #endif // TRI_H
@@ -2,96 +2,134 @@
 #define VECTOR3_H
 
 // ------------------------------------------------------
-// Class: vector3
+// Class: basic_vector3<T>
 // A simple 3D vector class with common operations
 // used for geometry, colors, and directions.
+//
+// T is the scalar type. The renderer uses vector3, which
+// is basic_vector3<real> (double, or float in a
+// RAYTRACER_FLOAT build; see ray_tracer.h).
+//
+// RAYTRACER_SIMD builds on x86 replace this generic version
+// with register-backed specializations (vector3_simd.h);
+// elsewhere the option falls back to it.
 // ------------------------------------------------------
-class vector3 {
+template <typename T>
+class basic_vector3 {
 public:
-    double e[3]; // x, y, z components
+    using value_type = T;
+
+    T e[3]; // x, y, z components
 
     // Constructors
-    vector3() : e{0,0,0} {}
-    vector3(double x, double y, double z) : e{x, y, z} {}
-    
+    basic_vector3() : e{0,0,0} {}
+    basic_vector3(T x, T y, T z) : e{x, y, z} {}
+
+    // Conversion from a vector of another precision
+    template <typename U>
+    explicit basic_vector3(const basic_vector3<U>& v) : e{T(v.e[0]), T(v.e[1]), T(v.e[2])} {}
+
     // Accessors
-    double x() const { return e[0]; }
-    double y() const { return e[1]; }
-    double z() const { return e[2]; }
+    T x() const { return e[0]; }
+    T y() const { return e[1]; }
+    T z() const { return e[2]; }
 
     // Unary minus
-    vector3 operator -() const { return vector3(-e[0], -e[1], -e[2]); }
+    basic_vector3 operator -() const { return basic_vector3(-e[0], -e[1], -e[2]); }
 
     // Index access
-    double operator[](int i) const { return e[i]; }
-    double& operator[](int i) { return e[i]; }
-    
+    T operator[](int i) const { return e[i]; }
+    T& operator[](int i) { return e[i]; }
+
     // Compound addition
-    vector3& operator+=(const vector3& v) {
+    basic_vector3& operator+=(const basic_vector3& v) {
         e[0] += v.e[0]; e[1] += v.e[1]; e[2] += v.e[2];
         return *this;
     }
 
     // Scalar multiplication
-    vector3& operator*=(double d) {
+    basic_vector3& operator*=(T d) {
         e[0] *= d; e[1] *= d; e[2] *= d;
         return *this;
     }
 
     // Length and squared length
-    double length() const { return std::sqrt(length_squared()); }
-    double length_squared() const { return e[0]*e[0] + e[1]*e[1] + e[2]*e[2]; }
+    T length() const { return std::sqrt(length_squared()); }
+    T length_squared() const { return e[0]*e[0] + e[1]*e[1] + e[2]*e[2]; }
 
     // Checks if vector is very close to zero in all components
     bool near_zero() const {
-        auto s = 1e-8;
+        T s = T(1e-8);
         return (std::fabs(e[0]) < s) && (std::fabs(e[1]) < s) && (std::fabs(e[2]) < s);
     }
 
     // Random vector in [0,1) or [min,max)
-    static vector3 random() { return vector3(random_double(), random_double(), random_double()); }
-    static vector3 random(double min, double max) {
-        return vector3(random_double(min,max), random_double(min,max), random_double(min,max));
+    static basic_vector3 random() {
+        return basic_vector3(T(random_double()), T(random_double()), T(random_double()));
+    }
+    static basic_vector3 random(double min, double max) {
+        return basic_vector3(T(random_double(min,max)), T(random_double(min,max)), T(random_double(min,max)));
     }
-    
+
     // Return a normalized version of the vector
-    vector3 normalize() const {
-        double len = length();
-        return vector3(e[0] / len, e[1] / len, e[2] / len);
+    basic_vector3 normalize() const {
+        T len = length();
+        return basic_vector3(e[0] / len, e[1] / len, e[2] / len);
     }
 };
 
+#if defined(RAYTRACER_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#include "vector3_simd.h"
+#endif
+
+using vector3 = basic_vector3<real>;
+
 // ------------------------------------------------------
 // Free functions for vector arithmetic
+// (scalars are taken as value_type, so a double literal
+// such as 0.5 also works with float vectors)
 // ------------------------------------------------------
-inline vector3 operator+(const vector3& v, const vector3& u) {
-    return vector3(v.e[0] + u.e[0], v.e[1] + u.e[1], v.e[2] + u.e[2]);
+template <typename T>
+inline basic_vector3<T> operator+(const basic_vector3<T>& v, const basic_vector3<T>& u) {
+    return basic_vector3<T>(v.e[0] + u.e[0], v.e[1] + u.e[1], v.e[2] + u.e[2]);
 }
 
-inline vector3 operator-(const vector3& v, const vector3& u) {
-    return vector3(v.e[0] - u.e[0], v.e[1] - u.e[1], v.e[2] - u.e[2]);
+template <typename T>
+inline basic_vector3<T> operator-(const basic_vector3<T>& v, const basic_vector3<T>& u) {
+    return basic_vector3<T>(v.e[0] - u.e[0], v.e[1] - u.e[1], v.e[2] - u.e[2]);
 }
 
-inline vector3 operator*(const vector3& v, const vector3& u) {
-    return vector3(v.e[0] * u.e[0], v.e[1] * u.e[1], v.e[2] * u.e[2]);
+template <typename T>
+inline basic_vector3<T> operator*(const basic_vector3<T>& v, const basic_vector3<T>& u) {
+    return basic_vector3<T>(v.e[0] * u.e[0], v.e[1] * u.e[1], v.e[2] * u.e[2]);
 }
 
-inline vector3 operator*(double d, const vector3& v) {
-    return vector3(v.e[0] * d, v.e[1] * d, v.e[2] * d);
+template <typename T>
+inline basic_vector3<T> operator*(typename basic_vector3<T>::value_type d, const basic_vector3<T>& v) {
+    return basic_vector3<T>(v.e[0] * d, v.e[1] * d, v.e[2] * d);
 }
-inline vector3 operator*(const vector3& v, double d) { return d * v; }
 
-inline vector3 operator/(const vector3& v, double d) { return (1/d) * v; }
+template <typename T>
+inline basic_vector3<T> operator*(const basic_vector3<T>& v, typename basic_vector3<T>::value_type d) {
+    return d * v;
+}
+
+template <typename T>
+inline basic_vector3<T> operator/(const basic_vector3<T>& v, typename basic_vector3<T>::value_type d) {
+    return (1/d) * v;
+}
 
 // ------------------------------------------------------
 // Vector math helpers
 // ------------------------------------------------------
-inline double dot(const vector3& v, const vector3& u) {
+template <typename T>
+inline T dot(const basic_vector3<T>& v, const basic_vector3<T>& u) {
     return v.e[0]*u.e[0] + v.e[1]*u.e[1] + v.e[2]*u.e[2];
 }
 
-inline vector3 cross(const vector3& v, const vector3& u) {
-    return vector3(
+template <typename T>
+inline basic_vector3<T> cross(const basic_vector3<T>& v, const basic_vector3<T>& u) {
+    return basic_vector3<T>(
         v.e[1]*u.e[2] - v.e[2]*u.e[1],
         v.e[2]*u.e[0] - v.e[0]*u.e[2],
         v.e[0]*u.e[1] - v.e[1]*u.e[0]
@@ -104,7 +142,7 @@ inline vector3 random_unit_vector() {
         auto p = vector3::random(-1, 1);
         auto lensq = p.length_squared();
         if (1e-160 < lensq && lensq <= 1)
-            return p / sqrt(lensq);
+            return p / std::sqrt(lensq);
     }
 }
 
@@ -119,4 +157,4 @@ inline vector3 reflect(const vector3& v, const vector3& n) {
     return v - 2 * dot(v, n) * n;
 }
 
-#endif // VECTOR3_H
\ No newline at end of file
+#endif // VECTOR3_H
@@ -0,0 +1,188 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "hittable.h"
+#include "material.h"
+#include "morton.h"
+
+// ============================================================
+// path_queue: path states for the wavefront integrator
+//
+// Instead of following one path from the camera to its last
+// bounce (the recursive ray_color), the wavefront integrator
+// keeps many paths in flight and advances all of them one
+// bounce at a time, in separate stages:
+//
+//   generate -> [ intersect all -> shade all -> compact ] -> ...
+//
+// Every field is its own array (structure of arrays), so each
+// stage streams through just the data it needs: intersection
+// reads origins and directions and writes hits; shading reads
+// hits and updates throughput, radiance and the next ray.
+//
+// The paths are also listed by the material type they hit
+// (misses, by_material), so the shade stage can run one loop
+// per type. compact() removes finished paths between
+// bounces, keeping the live ones packed at the front in their
+// original order.
+// sort_for_coherence() optionally reorders the live paths so
+// that rays traced one after another start close together
+// and point the same way.
+// ============================================================
+struct path_queue {
+    std::vector<vector3> origin;      // Current ray
+    std::vector<vector3> direction;
+    std::vector<color> throughput;    // Product of attenuations so far
+    std::vector<color> radiance;      // Light gathered so far
+    std::vector<uint32_t> pixel;      // Framebuffer index the path belongs to
+    std::vector<int> depth;           // Bounces left
+    std::vector<uint64_t> rng;        // Random generator state of the path
+    std::vector<uint8_t> hit;         // Result of the intersect stage
+    std::vector<hit_record> records;
+    std::vector<uint8_t> done;        // Set by the shade stage
+
+    // Indices of the paths that missed, and of those that hit
+    // each material type (see add_to_group())
+    std::vector<uint32_t> misses;
+    std::array<std::vector<uint32_t>, material_type_count> by_material;
+
+    size_t size() const { return origin.size(); }
+    bool empty() const { return origin.empty(); }
+
+    void reserve(size_t n) {
+        origin.reserve(n);     direction.reserve(n);
+        throughput.reserve(n); radiance.reserve(n);
+        pixel.reserve(n);      depth.reserve(n);
+        rng.reserve(n);        hit.reserve(n);
+        records.reserve(n);    done.reserve(n);
+    }
+
+    // Adds a new camera path
+    void push(const ray& r, uint32_t pixel_index, int max_depth, uint64_t random_state) {
+        origin.push_back(r.origin());
+        direction.push_back(r.direction());
+        throughput.push_back(color(1, 1, 1));
+        radiance.push_back(color(0, 0, 0));
+        pixel.push_back(pixel_index);
+        depth.push_back(max_depth);
+        rng.push_back(random_state);
+        hit.push_back(0);
+        records.emplace_back();
+        done.push_back(0);
+    }
+
+    // --------------------------------------------------------
+    // compact(retire)
+    // Calls retire(k) for every finished path k, then moves
+    // the remaining paths to the front and shrinks the queue.
+    // --------------------------------------------------------
+    template <typename Retire>
+    void compact(Retire&& retire) {
+        size_t live = 0;
+        for (size_t k = 0; k < size(); k++) {
+            if (done[k]) {
+                retire(k);
+                continue;
+            }
+            if (live != k) {
+                origin[live]     = origin[k];
+                direction[live]  = direction[k];
+                throughput[live] = throughput[k];
+                radiance[live]   = radiance[k];
+                pixel[live]      = pixel[k];
+                depth[live]      = depth[k];
+                rng[live]        = rng[k];
+            }
+            done[live] = 0;
+            live++;
+        }
+        resize(live);
+    }
+
+    void clear() { resize(0); }
+
+    // --------------------------------------------------------
+    // Material groups: the intersect stage calls
+    // clear_groups() and then add_to_group(k) for every path
+    // once its hit is known, while the record is still in
+    // cache; the shade stage then walks one list per type.
+    // --------------------------------------------------------
+    void clear_groups() {
+        misses.clear();
+        for (auto& group : by_material) group.clear();
+    }
+
+    void add_to_group(size_t k) {
+        if (!hit[k])
+            misses.push_back(uint32_t(k));
+        else
+            by_material[size_t(records[k].mat->data().type)].push_back(uint32_t(k));
+    }
+
+    // --------------------------------------------------------
+    // sort_for_coherence()
+    // Sorts the live paths by a key made of the direction
+    // octant of the ray (top 3 bits) and the Morton code of
+    // its origin on an 8-bit-per-axis grid over the bounds of
+    // all current origins (low 24 bits). Consecutive rays then
+    // traverse the same part of the BVH and touch the same
+    // nodes and primitives while they are still in cache.
+    // --------------------------------------------------------
+    void sort_for_coherence() {
+        const size_t n = size();
+        if (n < 2) return;
+
+        vector3 low = origin[0], high = origin[0];
+        for (const vector3& o : origin) {
+            for (int axis = 0; axis < 3; axis++) {
+                low[axis] = std::min(low[axis], o[axis]);
+                high[axis] = std::max(high[axis], o[axis]);
+            }
+        }
+
+        keys.resize(n);
+        for (size_t k = 0; k < n; k++) {
+            double p[3];
+            for (int axis = 0; axis < 3; axis++) {
+                double extent = high[axis] - low[axis];
+                p[axis] = extent > 0 ? (origin[k][axis] - low[axis]) / extent : 0.5;
+            }
+            uint64_t octant = (direction[k].x() < 0 ? 4 : 0) | (direction[k].y() < 0 ? 2 : 0)
+                            | (direction[k].z() < 0 ? 1 : 0);
+            uint64_t cell = morton_encode(p[0], p[1], p[2], 10) >> 6;  // 8 bits per axis
+            keys[k] = { (octant << 24) | cell, uint32_t(k) };
+        }
+        radix_sort(keys, 27, 1);  // Already on a render thread
+
+        gather(origin);     gather(direction);
+        gather(throughput); gather(radiance);
+        gather(pixel);      gather(depth);
+        gather(rng);
+    }
+
+  private:
+    std::vector<morton_key> keys;  // Scratch space for sort_for_coherence()
+
+    // Reorders 'values' into the sorted order of 'keys'
+    template <typename T>
+    void gather(std::vector<T>& values) {
+        std::vector<T> sorted(values.size());
+        for (size_t k = 0; k < keys.size(); k++) sorted[k] = values[keys[k].index];
+        values.swap(sorted);
+    }
+
+    void resize(size_t n) {
+        origin.resize(n);     direction.resize(n);
+        throughput.resize(n); radiance.resize(n);
+        pixel.resize(n);      depth.resize(n);
+        rng.resize(n);        hit.resize(n);
+        records.resize(n);    done.resize(n);
+    }
+};
+
+#endif // WAVEFRONT_H